@@ -123,6 +123,7 @@ PVR_ERROR PVRIptvData::GetConnectionString(std::string& connection)
 void PVRIptvData::Process()
 {
   unsigned int refreshTimer = 0;
+  unsigned int pruneTimer = 0;
   time_t lastRefreshTimeSeconds = std::time(nullptr);
   int lastRefreshHour = Settings::GetInstance().GetM3URefreshHour(); //ignore if we start during same hour
 
@@ -133,6 +134,7 @@ void PVRIptvData::Process()
     time_t currentRefreshTimeSeconds = std::time(nullptr);
     std::tm timeInfo = SafeLocaltime(currentRefreshTimeSeconds);
     refreshTimer += static_cast<unsigned int>(currentRefreshTimeSeconds - lastRefreshTimeSeconds);
+    pruneTimer += static_cast<unsigned int>(currentRefreshTimeSeconds - lastRefreshTimeSeconds);
     lastRefreshTimeSeconds = currentRefreshTimeSeconds;
 
     if (Settings::GetInstance().GetM3URefreshMode() == RefreshMode::REPEATED_REFRESH &&
@@ -143,18 +145,40 @@ void PVRIptvData::Process()
         lastRefreshHour != timeInfo.tm_hour && timeInfo.tm_hour == Settings::GetInstance().GetM3URefreshHour())
       m_reloadChannelsGroupsAndEPG = true;
 
-    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unique_lock<std::mutex> lock(m_mutex);
     if (m_running && m_reloadChannelsGroupsAndEPG)
     {
       std::this_thread::sleep_for(std::chrono::milliseconds(1000));
 
+      // A load in the background reads the settings and playlist so must not run while they change.
+      // It is waited for without the lock so Kodi's calls are not held up by a download finishing.
+      m_epg.CancelLoadingEPG();
+      lock.unlock();
+      m_epg.WaitForCancelledLoad();
+      lock.lock();
+      m_epg.StopLoadingEPG();
       Settings::GetInstance().ReloadAddonSettings();
       m_playlistLoader.ReloadPlayList();
       m_epg.ReloadEPG(); // Reloading EPG also updates media
 
       m_reloadChannelsGroupsAndEPG = false;
       refreshTimer = 0;
+      pruneTimer = 0;
+    }
+    else if (m_running && pruneTimer >= EPG_PRUNE_INTERVAL_SECS)
+    {
+      // Drop the programmes which have moved out of the EPG window since it was loaded
+      m_epg.PruneEpgEntries();
+      pruneTimer = 0;
     }
+
+    // Hand over any EPG loaded in the background and tell Kodi about it
+    if (m_running)
+      m_epg.PublishLoadedEPG();
+
+    // Move the programme on now for each channel on to the next as programmes end
+    if (m_running)
+      m_epg.AdvanceLiveEpgEntries();
     lastRefreshHour = timeInfo.tm_hour;
   }
 }
@@ -166,7 +190,12 @@ PVRIptvData::~PVRIptvData()
   if (m_thread.joinable())
     m_thread.join();
 
-  std::lock_guard<std::mutex> lock(m_mutex);
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_epg.CancelLoadingEPG();
+  lock.unlock();
+  m_epg.WaitForCancelledLoad();
+  lock.lock();
+  m_epg.StopLoadingEPG();
   m_channels.Clear();
   m_channelGroups.Clear();
   m_providers.Clear();
@@ -222,6 +251,12 @@ PVR_ERROR PVRIptvData::GetChannelStreamProperties(const kodi::addon::PVRChannel&
 {
   if (GetChannel(channel, m_currentChannel))
   {
+    {
+      // Its EPG is loaded first from now on
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_epg.SetPlayingChannel(m_currentChannel.GetUniqueId());
+    }
+
     std::string streamURL = m_currentChannel.GetStreamURL();
 
     m_catchupController.ResetCatchupState(); // TODO: we need this currently until we have a way to know the stream stops.
@@ -346,9 +381,9 @@ PVR_ERROR PVRIptvData::IsEPGTagPlayable(const kodi::addon::PVREPGTag& tag, bool&
   {
     // If we ignore catchup days then any tag can be played but only if it has a catchup ID
     bool hasCatchupId = false;
-    EpgEntry* epgEntry = m_catchupController.GetEPGEntry(channel, tag.GetStartTime());
-    if (epgEntry)
-      hasCatchupId = !epgEntry->GetCatchupId().empty();
+    EpgEntry epgEntry;
+    if (m_catchupController.GetEPGEntry(channel, tag.GetStartTime(), epgEntry))
+      hasCatchupId = !epgEntry.GetCatchupId().empty();
 
     bIsPlayable = bIsPlayable && hasCatchupId;
   }
@@ -365,12 +400,14 @@ PVR_ERROR PVRIptvData::IsEPGTagPlayable(const kodi::addon::PVREPGTag& tag, bool&
 
 PVR_ERROR PVRIptvData::SetEPGMaxPastDays(int epgMaxPastDays)
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_epg.SetEPGMaxPastDays(epgMaxPastDays);
   return PVR_ERROR_NO_ERROR;
 }
 
 PVR_ERROR PVRIptvData::SetEPGMaxFutureDays(int epgMaxFutureDays)
 {
+  std::lock_guard<std::mutex> lock(m_mutex);
   m_epg.SetEPGMaxFutureDays(epgMaxFutureDays);
   return PVR_ERROR_NO_ERROR;
 }
@@ -87,6 +87,7 @@ protected:
 
 private:
   static const int PROCESS_LOOP_WAIT_SECS = 2;
+  static const unsigned int EPG_PRUNE_INTERVAL_SECS = 60;
 
   iptvsimple::data::Channel m_currentChannel;
   iptvsimple::Providers m_providers;
@@ -94,7 +95,7 @@ private:
   iptvsimple::ChannelGroups m_channelGroups{m_channels};
   iptvsimple::Media m_media;
   iptvsimple::PlaylistLoader m_playlistLoader{this, m_channels, m_channelGroups, m_providers, m_media};
-  iptvsimple::Epg m_epg{this, m_channels, m_media};
+  iptvsimple::Epg m_epg{this, m_channels, m_channelGroups, m_media};
   iptvsimple::CatchupController m_catchupController{m_epg, &m_mutex};
 
   std::atomic<bool> m_running{false};
@@ -15,8 +15,9 @@
 #include "utilities/TimeUtils.h"
 #include "utilities/WebUtils.h"
 
+#include <ctime>
 #include <iomanip>
-#include <regex>
+#include <limits>
 
 #include <kodi/tools/StringUtils.h>
 
@@ -37,13 +38,13 @@ void CatchupController::ProcessChannelForPlayback(const Channel& channel, std::m
 
   if (!m_fromEpgTag || m_controlsLiveStream)
   {
-    EpgEntry* liveEpgEntry = GetLiveEPGEntry(channel);
-    if (m_controlsLiveStream && liveEpgEntry && !Settings::GetInstance().CatchupOnlyOnFinishedProgrammes())
+    EpgEntry liveEpgEntry;
+    if (m_controlsLiveStream && GetLiveEPGEntry(channel, liveEpgEntry) && !Settings::GetInstance().CatchupOnlyOnFinishedProgrammes())
     {
       // Live timeshifting support with EPG entry
-      UpdateProgrammeFrom(*liveEpgEntry, channel.GetTvgShift());
-      m_catchupStartTime = liveEpgEntry->GetStartTime();
-      m_catchupEndTime = liveEpgEntry->GetEndTime();
+      UpdateProgrammeFrom(liveEpgEntry, channel.GetTvgShift());
+      m_catchupStartTime = liveEpgEntry.GetStartTime();
+      m_catchupEndTime = liveEpgEntry.GetEndTime();
     }
     else if (m_controlsLiveStream || !channel.IsCatchupSupported() ||
              (!m_controlsLiveStream && channel.IsCatchupSupported()))
@@ -75,9 +76,9 @@ void CatchupController::ProcessChannelForPlayback(const Channel& channel, std::m
     }
     else
     {
-      EpgEntry* currentEpgEntry = GetEPGEntry(channel, m_timeshiftBufferStartTime + m_timeshiftBufferOffset);
-      if (currentEpgEntry)
-        UpdateProgrammeFrom(*currentEpgEntry, channel.GetTvgShift());
+      EpgEntry currentEpgEntry;
+      if (GetEPGEntry(channel, m_timeshiftBufferStartTime + m_timeshiftBufferOffset, currentEpgEntry))
+        UpdateProgrammeFrom(currentEpgEntry, channel.GetTvgShift());
     }
 
     m_catchupStartTime = m_timeshiftBufferStartTime;
@@ -92,9 +93,9 @@ void CatchupController::ProcessChannelForPlayback(const Channel& channel, std::m
 void CatchupController::ProcessEPGTagForTimeshiftedPlayback(const kodi::addon::PVREPGTag& epgTag, const Channel& channel, std::map<std::string, std::string>& catchupProperties)
 {
   m_programmeCatchupId.clear();
-  EpgEntry* epgEntry = GetEPGEntry(channel, epgTag.GetStartTime());
-  if (epgEntry)
-    m_programmeCatchupId = epgEntry->GetCatchupId();
+  EpgEntry epgEntry;
+  if (GetEPGEntry(channel, epgTag.GetStartTime(), epgEntry))
+    m_programmeCatchupId = epgEntry.GetCatchupId();
 
   StreamType streamType = StreamTypeLookup(channel, true);
 
@@ -135,9 +136,9 @@ void CatchupController::ProcessEPGTagForTimeshiftedPlayback(const kodi::addon::P
 void CatchupController::ProcessEPGTagForVideoPlayback(const kodi::addon::PVREPGTag& epgTag, const Channel& channel, std::map<std::string, std::string>& catchupProperties)
 {
   m_programmeCatchupId.clear();
-  EpgEntry* epgEntry = GetEPGEntry(channel, epgTag.GetStartTime());
-  if (epgEntry)
-    m_programmeCatchupId = epgEntry->GetCatchupId();
+  EpgEntry epgEntry;
+  if (GetEPGEntry(channel, epgTag.GetStartTime(), epgEntry))
+    m_programmeCatchupId = epgEntry.GetCatchupId();
 
   StreamType streamType = StreamTypeLookup(channel, true);
 
@@ -257,27 +258,36 @@ namespace
 {
 void FormatUnits(const std::string& name, time_t tTime, std::string &urlFormatString)
 {
-  const std::regex timeSecondsRegex(".*(\\{" + name + ":(\\d+)\\}).*");
-  std::cmatch mr;
-  if (std::regex_match(urlFormatString.c_str(), mr, timeSecondsRegex) && mr.length() >= 3)
+  // Find the last "{name:<divider>}" in the URL, each placeholder is scanned for directly
+  // as building a regex for every placeholder of every URL is far too slow
+  const std::string qualifier = "{" + name + ":";
+  size_t found = urlFormatString.rfind(qualifier);
+  while (found != std::string::npos)
   {
-    std::string timeSecondsExp = mr[1].first;
-    std::string second = mr[1].second;
-    if (second.length() > 0)
-      timeSecondsExp = timeSecondsExp.erase(timeSecondsExp.find(second));
-    std::string dividerStr = mr[2].first;
-    second = mr[2].second;
-    if (second.length() > 0)
-      dividerStr = dividerStr.erase(dividerStr.find(second));
-
-    const time_t divider = stoi(dividerStr);
-    if (divider != 0)
+    const size_t dividerStart = found + qualifier.size();
+    const size_t dividerEnd = urlFormatString.find_first_not_of("0123456789", dividerStart);
+    if (dividerEnd != dividerStart && dividerEnd != std::string::npos && urlFormatString[dividerEnd] == '}')
     {
-      time_t units = tTime / divider;
-      if (units < 0)
-        units = 0;
-      urlFormatString.replace(urlFormatString.find(timeSecondsExp), timeSecondsExp.length(), std::to_string(units));
+      time_t divider = 0;
+      for (size_t i = dividerStart; i < dividerEnd && divider <= std::numeric_limits<int>::max(); i++)
+        divider = divider * 10 + (urlFormatString[i] - '0');
+
+      if (divider != 0 && divider <= std::numeric_limits<int>::max())
+      {
+        time_t units = tTime / divider;
+        if (units < 0)
+          units = 0;
+
+        const std::string timeSecondsExp = urlFormatString.substr(found, dividerEnd - found + 1);
+        urlFormatString.replace(urlFormatString.find(timeSecondsExp), timeSecondsExp.length(), std::to_string(units));
+      }
+      return;
     }
+
+    if (found == 0)
+      break;
+
+    found = urlFormatString.rfind(qualifier, found - 1);
   }
 }
 
@@ -287,12 +297,12 @@ void FormatTime(const char ch, const struct tm *pTime, std::string &urlFormatStr
   size_t pos = urlFormatString.find(str);
   while (pos != std::string::npos)
   {
-    std::ostringstream os;
-    os << std::put_time(pTime, StringUtils::Format("%%%c", ch).c_str());
-    std::string timeString = os.str();
+    const char format[] = {'%', ch, '\0'};
+    char timeString[32];
+    const size_t timeStringLength = std::strftime(timeString, sizeof(timeString), format, pTime);
 
-    if (timeString.size() > 0)
-      urlFormatString.replace(pos, str.size(), timeString);
+    if (timeStringLength > 0)
+      urlFormatString.replace(pos, str.size(), timeString, timeStringLength);
 
     pos = urlFormatString.find(str);
   }
@@ -309,9 +319,15 @@ void FormatTime(const std::string name, const struct tm *pTime, std::string &url
     size_t foundEnd = urlFormatString.find("}", foundStart + 1);
     if (foundEnd != std::string::npos)
     {
-      std::string formatString = urlFormatString.substr(foundStart, foundEnd - foundStart);
-      const std::regex timeSpecifiers("([YmdHMS])");
-      formatString = std::regex_replace(formatString, timeSpecifiers, R"(%$&)");
+      std::string formatString;
+      formatString.reserve((foundEnd - foundStart) * 2);
+      for (size_t i = foundStart; i < foundEnd; i++)
+      {
+        const char c = urlFormatString[i];
+        if (c == 'Y' || c == 'm' || c == 'd' || c == 'H' || c == 'M' || c == 'S')
+          formatString += '%';
+        formatString += c;
+      }
 
       std::ostringstream os;
       os << std::put_time(pTime, formatString.c_str());
@@ -426,9 +442,8 @@ std::string BuildEpgTagUrl(time_t startTime, time_t duration, const Channel& cha
   else
     startTimeUrl = FormatDateTimeNowOnly(channel.GetStreamURL(), timezoneShiftSecs);
 
-  static const std::regex CATCHUP_ID_REGEX("\\{catchup-id\\}");
   if (!programmeCatchupId.empty())
-    startTimeUrl = std::regex_replace(startTimeUrl, CATCHUP_ID_REGEX, programmeCatchupId);
+    StringUtils::Replace(startTimeUrl, "{catchup-id}", programmeCatchupId);
 
   Logger::Log(LEVEL_DEBUG, "%s - %s", __FUNCTION__, WebUtils::RedactUrl(startTimeUrl).c_str());
 
@@ -496,16 +511,16 @@ std::string CatchupController::GetStreamKey(const Channel& channel, bool fromEpg
   return std::to_string(channel.GetUniqueId()) + "-" + channel.GetStreamURL();
 }
 
-EpgEntry* CatchupController::GetLiveEPGEntry(const Channel& myChannel)
+bool CatchupController::GetLiveEPGEntry(const Channel& myChannel, EpgEntry& epgEntry)
 {
   std::lock_guard<std::mutex> lock(*m_mutex);
 
-  return m_epg.GetLiveEPGEntry(myChannel);
+  return m_epg.GetLiveEPGEntry(myChannel, epgEntry);
 }
 
-EpgEntry* CatchupController::GetEPGEntry(const Channel& myChannel, time_t lookupTime)
+bool CatchupController::GetEPGEntry(const Channel& myChannel, time_t lookupTime, EpgEntry& epgEntry)
 {
   std::lock_guard<std::mutex> lock(*m_mutex);
 
-  return m_epg.GetEPGEntry(myChannel, lookupTime);
+  return m_epg.GetEPGEntry(myChannel, lookupTime, epgEntry);
 }
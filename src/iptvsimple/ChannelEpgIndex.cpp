@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ChannelEpgIndex.h"
+
+#include <kodi/tools/StringUtils.h>
+
+using namespace kodi::tools;
+using namespace iptvsimple;
+
+void ChannelEpgIndex::AddId(const std::string& id, size_t channelEpgIndex)
+{
+  Add(m_indexesById, id, channelEpgIndex);
+}
+
+void ChannelEpgIndex::AddDisplayName(const std::string& displayName, const std::string& displayNameWithUnderscores, size_t channelEpgIndex)
+{
+  Add(m_indexesByDisplayName, displayName, channelEpgIndex);
+  Add(m_indexesByTvgName, displayName, channelEpgIndex);
+  Add(m_indexesByTvgName, displayNameWithUnderscores, channelEpgIndex);
+}
+
+void ChannelEpgIndex::ClearDisplayNames()
+{
+  m_indexesByDisplayName.clear();
+  m_indexesByTvgName.clear();
+}
+
+void ChannelEpgIndex::Clear()
+{
+  m_indexesById.clear();
+  ClearDisplayNames();
+}
+
+bool ChannelEpgIndex::FindById(const std::string& id, size_t& channelEpgIndex) const
+{
+  return Find(m_indexesById, id, channelEpgIndex);
+}
+
+bool ChannelEpgIndex::FindByNames(const std::string& tvgId, const std::string& tvgName, const std::string& displayName, size_t& channelEpgIndex) const
+{
+  return Find(m_indexesById, tvgId, channelEpgIndex) ||
+         Find(m_indexesByTvgName, tvgName, channelEpgIndex) ||
+         Find(m_indexesByDisplayName, displayName, channelEpgIndex);
+}
+
+void ChannelEpgIndex::Add(std::unordered_map<std::string, size_t>& indexes, std::string key, size_t channelEpgIndex)
+{
+  StringUtils::ToLower(key);
+  indexes.emplace(key, channelEpgIndex);
+}
+
+bool ChannelEpgIndex::Find(const std::unordered_map<std::string, size_t>& indexes, std::string key, size_t& channelEpgIndex)
+{
+  StringUtils::ToLower(key);
+
+  auto found = indexes.find(key);
+  if (found == indexes.end())
+    return false;
+
+  channelEpgIndex = found->second;
+  return true;
+}
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+
+namespace iptvsimple
+{
+  /*
+   * Finds the index of a channel EPG by its id or display names without searching them all.
+   * Keys are compared without case. Where more than one channel EPG has the same display name
+   * the first one added is found, so adding them in file order finds the same channel EPG the
+   * searches through the channel EPGs did.
+   */
+  class ChannelEpgIndex
+  {
+  public:
+    // Ids are added as the channel EPGs are loaded, an id already added keeps its channel EPG
+    void AddId(const std::string& id, size_t channelEpgIndex);
+    // Display names are added once all the channel EPGs have been combined
+    void AddDisplayName(const std::string& displayName, const std::string& displayNameWithUnderscores, size_t channelEpgIndex);
+    void ClearDisplayNames();
+    void Clear();
+
+    bool FindById(const std::string& id, size_t& channelEpgIndex) const;
+    // By tvg-id, then tvg-name with or without underscores and last of all the channel name
+    bool FindByNames(const std::string& tvgId, const std::string& tvgName, const std::string& displayName, size_t& channelEpgIndex) const;
+
+    size_t GetDisplayNameCount() const { return m_indexesByTvgName.size(); }
+
+  private:
+    static void Add(std::unordered_map<std::string, size_t>& indexes, std::string key, size_t channelEpgIndex);
+    static bool Find(const std::unordered_map<std::string, size_t>& indexes, std::string key, size_t& channelEpgIndex);
+
+    std::unordered_map<std::string, size_t> m_indexesById;
+    std::unordered_map<std::string, size_t> m_indexesByDisplayName;
+    std::unordered_map<std::string, size_t> m_indexesByTvgName; // With or without underscores
+  };
+} //namespace iptvsimple
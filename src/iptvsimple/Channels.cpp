@@ -12,8 +12,6 @@
 #include "utilities/FileUtils.h"
 #include "utilities/Logger.h"
 
-#include <regex>
-
 #include <kodi/tools/StringUtils.h>
 
 using namespace kodi::tools;
@@ -142,7 +140,8 @@ const Channel* Channels::FindChannel(const std::string& id, const std::string& d
   if (displayName.empty())
     return nullptr;
 
-  const std::string convertedDisplayName = std::regex_replace(displayName, std::regex(" "), "_");
+  std::string convertedDisplayName = displayName;
+  StringUtils::Replace(convertedDisplayName, ' ', '_');
   for (const auto& myChannel : m_channels)
   {
     if (StringUtils::EqualsNoCase(myChannel.GetTvgName(), convertedDisplayName) ||
@@ -8,12 +8,20 @@
 #include "Epg.h"
 
 #include "Settings.h"
+#include "utilities/ChunkQueue.h"
 #include "utilities/FileUtils.h"
 #include "utilities/Logger.h"
+#include "utilities/MemoryUtils.h"
+#include "utilities/ScanUtils.h"
+#include "utilities/WorkerPool.h"
 #include "utilities/XMLUtils.h"
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <regex>
+#include <deque>
+#include <limits>
+#include <memory>
 #include <thread>
 
 #include <kodi/tools/StringUtils.h>
@@ -25,19 +33,109 @@ using namespace iptvsimple::data;
 using namespace iptvsimple::utilities;
 using namespace pugi;
 
-Epg::Epg(kodi::addon::CInstancePVRClient* client, Channels& channels, Media& media)
-  : m_lastStart(0), m_lastEnd(0), m_channels(channels), m_media(media), m_client(client)
+namespace
 {
-  FileUtils::CopyDirectory(FileUtils::GetResourceDataPath() + GENRE_DIR, GENRE_ADDON_DATA_BASE_DIR, true);
 
-  if (!FileUtils::FileExists(DEFAULT_GENRE_TEXT_MAP_FILE))
+// How far past the end of the window loaded the programmes after it are kept for moving it on,
+// and the most markup kept for them. A window moving on further loads the EPG again.
+const time_t LATER_PROGRAMMES_HORIZON_SECS = 24 * 60 * 60;
+const size_t MAX_LATER_PROGRAMME_BYTES = 64 * 1024 * 1024;
+
+// The number of programmes handed to a worker at a time in parallel load mode
+const size_t PROGRAMME_BATCH_SIZE = 512;
+
+struct ProgrammeBatch
+{
+  struct Programme
   {
-    MoveOldGenresXMLFileToNewLocation();
+    size_t m_dataOffset;
+    size_t m_length;
+    size_t m_streamOffset;
+    ChannelEpg* m_channelEpg;
+    std::string m_id;
+  };
+
+  void AddProgramme(const XmltvElement& element, ChannelEpg* channelEpg)
+  {
+    m_programmes.push_back({m_data.size(), element.m_length, element.m_offset, channelEpg, element.m_id});
+    m_data.append(element.m_data, element.m_length);
   }
+
+  std::string m_data;
+  std::vector<Programme> m_programmes;
+  std::vector<std::pair<ChannelEpg*, EpgEntry>> m_entries;
+  std::future<void> m_parsed;
+};
+
+void ParseProgrammeBatch(ProgrammeBatch& batch, time_t start, time_t end, int minShiftTime, int maxShiftTime, StringPool& stringPool)
+{
+  xml_document xmlDoc;
+
+  for (const auto& programme : batch.m_programmes)
+  {
+    XmltvElement element;
+    element.m_type = XmltvElementType::PROGRAMME;
+    element.m_data = &batch.m_data[programme.m_dataOffset];
+    element.m_length = programme.m_length;
+    element.m_offset = programme.m_streamOffset;
+
+    if (!XmltvParser::LoadElement(element, xmlDoc))
+      continue;
+
+    EpgEntry entry;
+    if (entry.UpdateFrom(xmlDoc.first_child(), programme.m_id, start, end, minShiftTime, maxShiftTime, stringPool))
+      batch.m_entries.emplace_back(programme.m_channelEpg, entry);
+  }
+
+  // The markup is no longer needed, only the entries
+  std::string().swap(batch.m_data);
+}
+
+// The channel EPGs loaded at a time when loading progressively, each batch is published together
+const size_t PRIORITY_LOAD_BATCH_SIZE = 32;
+
+const size_t NO_CHANNEL_EPG_INDEX = static_cast<size_t>(-1);
+
+// Channels with fewer entries than this are not worth checking for duplicates
+const size_t MIN_SHARED_EPG_ENTRY_COUNT = 4;
+
+// The programmes of a channel EPG used to look for other channel EPGs with the same schedule
+const size_t SHARED_EPG_ANCHOR_COUNT = 4;
+
+// Limits how many channel EPGs an anchor is compared with when many show the same programme
+const size_t MAX_SHARED_EPG_CANDIDATES = 8;
+
+// Identifies a programme regardless of the channel and time it is broadcast
+size_t HashProgramme(const EpgEntry& epgEntry)
+{
+  size_t hash = std::hash<std::string>()(epgEntry.GetTitle());
+  hash = hash * 31 + std::hash<std::string>()(epgEntry.GetEpisodeName());
+  hash = hash * 31 + std::hash<std::string>()(epgEntry.GetPlot());
+  hash = hash * 31 + std::hash<time_t>()(epgEntry.GetEndTime() - epgEntry.GetStartTime());
+  return hash;
+}
+
+} // unnamed namespace
+
+Epg::Epg(kodi::addon::CInstancePVRClient* client, Channels& channels, ChannelGroups& channelGroups, Media& media)
+  : m_channels(channels), m_channelGroups(channelGroups), m_media(media), m_client(client)
+{
+}
+
+Epg::~Epg()
+{
+  StopLoadingEPG();
 }
 
 bool Epg::Init(int epgMaxPastDays, int epgMaxFutureDays)
 {
+  FileUtils::CopyDirectory(FileUtils::GetResourceDataPath() + GENRE_DIR, GENRE_ADDON_DATA_BASE_DIR, true);
+
+  if (!FileUtils::FileExists(DEFAULT_GENRE_TEXT_MAP_FILE))
+  {
+    MoveOldGenresXMLFileToNewLocation();
+  }
+
   m_xmltvLocation = Settings::GetInstance().GetEpgLocation();
   m_epgTimeShift = Settings::GetInstance().GetEpgTimeshiftSecs();
   m_tsOverride = Settings::GetInstance().GetTsOverride();
@@ -51,8 +149,7 @@ bool Epg::Init(int epgMaxPastDays, int epgMaxFutureDays)
     // or not kodi considers it necessary when either 1) we need the EPG logos or 2) for
     // catchup we need a local store of the EPG data
     time_t now = std::time(nullptr);
-    LoadEPG(now - m_epgMaxPastDaysSeconds, now + m_epgMaxFutureDaysSeconds);
-    MergeEpgDataIntoMedia();
+    LoadEPGForWindow(now - m_epgMaxPastDaysSeconds, now + m_epgMaxFutureDaysSeconds);
   }
 
   return true;
@@ -60,8 +157,18 @@ bool Epg::Init(int epgMaxPastDays, int epgMaxFutureDays)
 
 void Epg::Clear()
 {
+  StopLoadingEPG();
+  m_loadState = EpgLoadState::NOT_LOADED;
+  m_loadWindow.Clear();
+
   m_channelEpgs.clear();
+  ClearChannelEpgIndexes();
+  ClearLiveEpgEntries();
   m_genreMappings.clear();
+  m_genreMappingsByName.clear();
+  m_stringPool.Clear();
+  ClearDeferredProgrammeData();
+  ClearLaterProgrammeData();
 }
 
 void Epg::SetEPGMaxPastDays(int epgMaxPastDays)
@@ -72,6 +179,8 @@ void Epg::SetEPGMaxPastDays(int epgMaxPastDays)
     m_epgMaxPastDaysSeconds = m_epgMaxPastDays * 24 * 60 * 60;
   else
     m_epgMaxPastDaysSeconds = DEFAULT_EPG_MAX_DAYS * 24 * 60 * 60;
+
+  PruneEpgEntries();
 }
 
 void Epg::SetEPGMaxFutureDays(int epgMaxFutureDays)
@@ -82,6 +191,50 @@ void Epg::SetEPGMaxFutureDays(int epgMaxFutureDays)
     m_epgMaxFutureDaysSeconds = m_epgMaxFutureDays * 24 * 60 * 60;
   else
     m_epgMaxFutureDaysSeconds = DEFAULT_EPG_MAX_DAYS * 24 * 60 * 60;
+
+  PruneEpgEntries();
+}
+
+void Epg::PruneEpgEntries()
+{
+  if (m_channelEpgs.empty())
+    return;
+
+  auto started = std::chrono::high_resolution_clock::now();
+
+  const time_t now = std::time(nullptr);
+  const time_t start = now - m_epgMaxPastDaysSeconds;
+  const time_t end = now + m_epgMaxFutureDaysSeconds;
+
+  // Only entries outside of the window for every channel's time shift can go, as when loading
+  int minShiftTime;
+  int maxShiftTime;
+  GetEpgShiftRange(minShiftTime, maxShiftTime);
+
+  size_t prunedCount = 0;
+  for (auto& myChannelEpg : m_channelEpgs)
+    prunedCount += myChannelEpg.PruneEpgEntries(start - maxShiftTime, end - minShiftTime);
+
+  // A window reaching past the programmes kept has to be loaded again if asked for
+  m_loadWindow.PruneTo(end);
+
+  // Programmes still to be loaded on demand are limited to the window too
+  if (m_deferredEnd > 0)
+  {
+    m_deferredStart = std::max(m_deferredStart, start);
+    m_deferredEnd = std::min(m_deferredEnd, end);
+  }
+
+  if (prunedCount == 0)
+    return;
+
+  ChannelEpg::CompactEpgEntryStores(m_channelEpgs);
+  ClearLiveEpgEntries();
+
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Pruned %zu EPG entries outside of the EPG window in %d (ms)", __FUNCTION__, prunedCount, milliseconds);
 }
 
 bool Epg::LoadEPG(time_t start, time_t end)
@@ -95,260 +248,1345 @@ bool Epg::LoadEPG(time_t start, time_t end)
     return false;
   }
 
+  size_t heapInUseBefore = 0;
+  size_t heapFreeBefore = 0;
+  const bool haveHeapUsage = MemoryUtils::GetHeapUsage(heapInUseBefore, heapFreeBefore);
+
   std::string data;
 
   if (GetXMLTVFileWithRetries(data))
   {
-    std::string decompressedData;
-    char* buffer = FillBufferFromXMLTVData(data, decompressedData);
+    bool parsed = ParseXMLTV(data, start, end) && !m_loadCancelled;
+    IndexChannelEpgs();
 
-    if (!buffer)
+    // Everything the parse needed is gone now, only the EPG entries themselves remain
+    std::string().swap(data);
+    MemoryUtils::ReleaseFreeHeapMemory();
+
+    if (!parsed)
       return false;
+  }
+  else
+  {
+    return false;
+  }
+
+  size_t heapInUseAfter = 0;
+  size_t heapFreeAfter = 0;
+  if (haveHeapUsage && MemoryUtils::GetHeapUsage(heapInUseAfter, heapFreeAfter))
+  {
+    auto fragmentation = [](size_t inUse, size_t free) { return inUse + free > 0 ? 100.0 * free / (inUse + free) : 0.0; };
+    Logger::Log(LEVEL_DEBUG, "%s - Heap in use %zu bytes with %zu bytes free (%.1f%% fragmentation) before load, %zu bytes with %zu bytes free (%.1f%% fragmentation) after", __FUNCTION__,
+                heapInUseBefore, heapFreeBefore, fragmentation(heapInUseBefore, heapFreeBefore),
+                heapInUseAfter, heapFreeAfter, fragmentation(heapInUseAfter, heapFreeAfter));
+  }
+
+  LoadGenres();
+
+  // Genres are resolved once per distinct category string so there is nothing to do per tag
+  std::unordered_map<std::string, const EpgGenre*> resolvedGenreStrings;
+  for (auto& channelEpg : m_channelEpgs)
+    ApplyGenreMappings(channelEpg, resolvedGenreStrings);
 
-    xml_document xmlDoc;
-    xml_parse_result result = xmlDoc.load_string(buffer);
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_INFO, "%s - EPG Loaded - %d (ms)", __FUNCTION__, milliseconds);
+
+  return true;
+}
+
+bool Epg::GetXMLTVFileWithRetries(std::string& data)
+{
+  int bytesRead = 0;
+  int count = 0;
+
+  // Cache is only allowed if refresh mode is disabled
+  bool useEPGCache = Settings::GetInstance().GetM3URefreshMode() != RefreshMode::DISABLED ? false : Settings::GetInstance().UseEPGCache();
 
-    if (!result)
+  while (count < 3 && !m_loadCancelled) // max 3 tries
+  {
+    if ((bytesRead = FileUtils::GetCachedFileContents(XMLTV_CACHE_FILENAME, m_xmltvLocation, data, useEPGCache, &m_loadCancelled)) != 0)
+      break;
+
+    Logger::Log(LEVEL_ERROR, "%s - Unable to load EPG file '%s':  file is missing or empty. :%dth try.", __FUNCTION__, m_xmltvLocation.c_str(), ++count);
+
+    // sleep 2 sec before next try, in short steps so a cancelled load does not wait it out
+    for (int sleepStep = 0; count < 3 && sleepStep < 20 && !m_loadCancelled; sleepStep++)
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+
+  if (bytesRead == 0)
+  {
+    if (!m_loadCancelled)
+      Logger::Log(LEVEL_ERROR, "%s - Unable to load EPG file '%s':  file is missing or empty. After %d tries.", __FUNCTION__, m_xmltvLocation.c_str(), count);
+    return false;
+  }
+
+  return true;
+}
+
+const XmltvCompression Epg::GetXMLTVCompression(const std::string& data)
+{
+  // gzip packed
+  if (data.size() >= 3 && data[0] == '\x1F' && data[1] == '\x8B' && data[2] == '\x08')
+    return XmltvCompression::GZIP;
+
+  // xz packed
+  if (data.size() >= 6 && data[0] == '\xFD' && data[1] == '7' && data[2] == 'z' &&
+      data[3] == 'X' && data[4] == 'Z' && data[5] == '\x00')
+    return XmltvCompression::XZ;
+
+  return XmltvCompression::NONE;
+}
+
+bool Epg::DecompressXMLTVData(const std::string& data, XmltvCompression compression, const XmltvChunkHandler& chunkHandler) const
+{
+  // Decompression runs on its own thread handing the data over in chunks, so parsing
+  // runs alongside it and the whole of the decompressed file is never held in memory.
+  ChunkQueue chunkQueue(XMLTV_MAX_QUEUED_CHUNKS);
+  bool decompressed = false;
+  size_t decompressedSize = 0;
+  int milliseconds = 0;
+
+  std::thread decompressThread([&]()
+  {
+    auto started = std::chrono::high_resolution_clock::now();
+
+    auto queueChunk = [&chunkQueue, &decompressedSize](std::string& chunk)
     {
-      std::string errorString;
-      int offset = GetParseErrorString(buffer, result.offset, errorString);
-      Logger::Log(LEVEL_ERROR, "%s - Unable parse EPG XML: %s, offset: %d: \n[ %s \n]", __FUNCTION__, result.description(), offset, errorString.c_str());
-      return false;
+      decompressedSize += chunk.size();
+      return chunkQueue.Push(std::move(chunk));
+    };
+
+    if (compression == XmltvCompression::GZIP)
+      decompressed = FileUtils::GzipInflate(data, queueChunk);
+    else
+      decompressed = FileUtils::XzDecompress(data, queueChunk);
+
+    chunkQueue.Close();
+
+    milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::high_resolution_clock::now() - started).count();
+  });
+
+  bool handled = true;
+  std::string chunk;
+  while (chunkQueue.Pop(chunk))
+  {
+    if (!chunkHandler(&chunk[0], chunk.size()))
+    {
+      // Nothing more will be parsed so there is no point decompressing the rest
+      handled = false;
+      chunkQueue.Cancel();
+      break;
     }
+  }
+
+  decompressThread.join();
+
+  if (handled)
+    Logger::Log(LEVEL_DEBUG, "%s - Decompressed %zu bytes of EPG data to %zu bytes in %d (ms)", __FUNCTION__, data.size(), decompressedSize, milliseconds);
+
+  return decompressed || !handled;
+}
 
-    const auto& rootElement = xmlDoc.child("tv");
-    if (!rootElement)
+const XmltvFileFormat Epg::GetXMLTVFileFormat(const char* buffer, size_t length)
+{
+  if (!buffer || length < 5)
+    return XmltvFileFormat::INVALID;
+
+  // xml should starts with '<?xml'
+  if (buffer[0] != '\x3C' || buffer[1] != '\x3F' || buffer[2] != '\x78' ||
+      buffer[3] != '\x6D' || buffer[4] != '\x6C')
+  {
+    // check for BOM
+    if (buffer[0] != '\xEF' || buffer[1] != '\xBB' || buffer[2] != '\xBF')
     {
-      Logger::Log(LEVEL_ERROR, "%s - Invalid EPG XML: no <tv> tag found", __FUNCTION__);
-      return false;
+      // check for tar archive
+      if (length < 0x200)
+        return XmltvFileFormat::INVALID;
+
+      if (strcmp(buffer + 0x101, "ustar") || strcmp(buffer + 0x101, "GNUtar"))
+        return XmltvFileFormat::TAR_ARCHIVE;
+      else
+        return XmltvFileFormat::INVALID;
     }
+  }
 
-    if (!LoadChannelEpgs(rootElement))
+  return XmltvFileFormat::NORMAL;
+}
+
+bool Epg::ParseXMLTV(std::string& data, time_t start, time_t end)
+{
+  auto started = std::chrono::high_resolution_clock::now();
+
+  m_channelEpgs.clear();
+  ClearChannelEpgIndexes();
+  ClearLiveEpgEntries();
+  m_stringPool.Clear();
+  ClearDeferredProgrammeData();
+  ClearLaterProgrammeData();
+
+  int minShiftTime;
+  int maxShiftTime;
+  GetEpgShiftRange(minShiftTime, maxShiftTime);
+
+  m_laterProgrammesFrom = end;
+  m_laterProgrammesUntil = end + LATER_PROGRAMMES_HORIZON_SECS;
+  m_laterMinShiftTime = minShiftTime;
+  m_laterMaxShiftTime = maxShiftTime;
+  std::string programmeStart;
+
+  // When loading on demand only the markup of each programme is kept on load, they are
+  // parsed the first time the entries of their channel are needed, or by order of priority
+  // once the channel EPGs have been published when loading progressively
+  const bool loadOnDemand = Settings::GetInstance().GetEpgLoadMode() == EpgLoadMode::ON_DEMAND ||
+                            Settings::GetInstance().GetEpgLoadMode() == EpgLoadMode::PROGRESSIVE;
+  m_deferredStart = start;
+  m_deferredEnd = end;
+  m_deferredMinShiftTime = minShiftTime;
+  m_deferredMaxShiftTime = maxShiftTime;
+
+  xml_document xmlDoc;
+  ChannelEpg* channelEpg = nullptr;
+  bool channelEpgsChecked = false;
+  int count = 0;
+
+  // In parallel mode programmes are collected into batches in file order and parsed by the
+  // worker pool. Batches are merged strictly in the order they were created so the result
+  // is exactly the same as parsing each programme in turn. The batches must outlive the pool.
+  std::deque<std::unique_ptr<ProgrammeBatch>> programmeBatches;
+  std::unique_ptr<ProgrammeBatch> programmeBatch;
+  std::unique_ptr<WorkerPool> workerPool;
+  if (Settings::GetInstance().GetEpgLoadMode() == EpgLoadMode::PARALLEL)
+    workerPool.reset(new WorkerPool(WorkerPool::GetDefaultThreadCount()));
+
+  auto mergeProgrammeBatch = [&]()
+  {
+    std::unique_ptr<ProgrammeBatch> batch = std::move(programmeBatches.front());
+    programmeBatches.pop_front();
+
+    batch->m_parsed.wait();
+    for (const auto& entryPair : batch->m_entries)
+      entryPair.first->AddEpgEntry(entryPair.second);
+
+    count += batch->m_entries.size();
+  };
+
+  auto submitProgrammeBatch = [&]()
+  {
+    if (!programmeBatch)
+      return;
+
+    ProgrammeBatch* batch = programmeBatch.get();
+    StringPool& stringPool = m_stringPool;
+    batch->m_parsed = workerPool->Submit([batch, start, end, minShiftTime, maxShiftTime, &stringPool]()
+    {
+      ParseProgrammeBatch(*batch, start, end, minShiftTime, maxShiftTime, stringPool);
+    });
+    programmeBatches.emplace_back(std::move(programmeBatch));
+
+    // Merge whatever is ready and limit the batches in flight to keep memory use bound
+    while (!programmeBatches.empty() &&
+           (programmeBatches.size() > workerPool->GetThreadCount() * 2 ||
+            programmeBatches.front()->m_parsed.wait_for(std::chrono::seconds(0)) == std::future_status::ready))
+      mergeProgrammeBatch();
+  };
+
+  auto mergeAllProgrammeBatches = [&]()
+  {
+    submitProgrammeBatch();
+    while (!programmeBatches.empty())
+      mergeProgrammeBatch();
+  };
+
+  // Each element is parsed on its own as it is found so the DOM never holds more than
+  // a single channel or programme. Programmes for channels we don't know are skipped
+  // without being parsed at all.
+  XmltvParser parser([&](const XmltvElement& element)
+  {
+    if (m_loadCancelled)
       return false;
 
-    LoadEpgEntries(rootElement, start, end);
+    if (element.m_type == XmltvElementType::CHANNEL)
+    {
+      // A channel after the programmes have started may move the channel EPGs in memory
+      if (channelEpgsChecked)
+      {
+        if (workerPool)
+          mergeAllProgrammeBatches();
+        channelEpg = nullptr;
+      }
+
+      LoadChannelEpg(element, xmlDoc);
+      return true;
+    }
+
+    // All the channels come before the first programme
+    if (!channelEpgsChecked)
+    {
+      channelEpgsChecked = true;
+      if (!CheckChannelEpgsLoaded())
+        return false;
+    }
+
+    if (!FindEpgForProgramme(element, channelEpg))
+      return true;
+
+    // Programmes starting after the window for every shift are kept as they are for when it moves on
+    if (XmltvParser::GetElementAttribute(element, "start", programmeStart))
+    {
+      const time_t startTime = static_cast<time_t>(EpgEntry::ParseXmltvDateTime(programmeStart));
+      if (startTime + minShiftTime > end)
+      {
+        if (m_laterProgrammesFrom == 0 || startTime + minShiftTime > m_laterProgrammesUntil)
+          return true;
+
+        // Rather than keep more, the window is loaded again when it moves on
+        if (m_laterProgrammeData.size() + element.m_length > MAX_LATER_PROGRAMME_BYTES)
+        {
+          Logger::Log(LEVEL_DEBUG, "%s - Over %zu bytes of programmes after the EPG window, none are kept to move it on with", __FUNCTION__, MAX_LATER_PROGRAMME_BYTES);
+          ClearLaterProgrammeData();
+          for (auto& myChannelEpg : m_channelEpgs)
+            myChannelEpg.ClearLaterProgrammes();
+          return true;
+        }
+
+        channelEpg->AddLaterProgramme(startTime, m_laterProgrammeData.size(), element.m_length);
+        m_laterProgrammeData.append(element.m_data, element.m_length);
+        return true;
+      }
+    }
+
+    if (workerPool)
+    {
+      if (!programmeBatch)
+        programmeBatch.reset(new ProgrammeBatch());
+
+      programmeBatch->AddProgramme(element, channelEpg);
+      if (programmeBatch->m_programmes.size() >= PROGRAMME_BATCH_SIZE)
+        submitProgrammeBatch();
+    }
+    else if (loadOnDemand)
+    {
+      if (!channelEpg->HasDeferredProgrammes())
+        m_deferredChannelCount++;
+
+      channelEpg->AddDeferredProgramme(m_deferredProgrammeData.size(), element.m_length);
+      m_deferredProgrammeData.append(element.m_data, element.m_length);
+      count++;
+    }
+    else if (LoadEpgEntry(element, xmlDoc, channelEpg, start, end, minShiftTime, maxShiftTime))
+    {
+      count++;
+    }
+
+    return true;
+  });
+
+  bool formatChecked = false;
+  bool validFormat = false;
+
+  auto parseChunk = [&](char* chunk, size_t length)
+  {
+    // The file format can only be checked once the first chunk of data is available
+    if (!formatChecked)
+    {
+      formatChecked = true;
+
+      XmltvFileFormat fileFormat = GetXMLTVFileFormat(chunk, length);
+      if (fileFormat == XmltvFileFormat::INVALID)
+        return false;
+
+      if (fileFormat == XmltvFileFormat::TAR_ARCHIVE)
+      {
+        chunk += 0x200; // RECORDSIZE = 512
+        length -= 0x200;
+      }
+
+      validFormat = true;
+    }
+
+    return parser.Parse(chunk, length);
+  };
+
+  const XmltvCompression compression = GetXMLTVCompression(data);
+  if (compression == XmltvCompression::NONE)
+  {
+    // The elements are parsed in place, there's no need for another copy of the data
+    parseChunk(&data[0], data.size());
+  }
+  else if (!DecompressXMLTVData(data, compression, parseChunk))
+  {
+    Logger::Log(LEVEL_ERROR, "%s - Invalid EPG file '%s': unable to decompress %s file.", __FUNCTION__, m_xmltvLocation.c_str(),
+                compression == XmltvCompression::GZIP ? "gzip" : "xz/7z");
+    return false;
+  }
+
+  if (!validFormat)
+  {
+    Logger::Log(LEVEL_ERROR, "%s - Invalid EPG file '%s': unable to parse file.", __FUNCTION__, m_xmltvLocation.c_str());
+    return false;
+  }
+
+  if (!parser.Finish())
+    return false;
+
+  if (workerPool)
+    mergeAllProgrammeBatches();
+
+  if (!parser.FoundRootElement())
+  {
+    Logger::Log(LEVEL_ERROR, "%s - Invalid EPG XML: no <tv> tag found", __FUNCTION__);
+    return false;
+  }
+
+  if (!channelEpgsChecked && !CheckChannelEpgsLoaded())
+    return false;
+
+  xmlDoc.reset();
+
+  // Channels are independent of each other so in parallel mode they are finished on the pool
+  auto forEachChannelEpg = [&](const std::function<void(ChannelEpg&)>& action)
+  {
+    if (workerPool)
+    {
+      std::vector<std::future<void>> channelsFinished;
+      for (auto& myChannelEpg : m_channelEpgs)
+        channelsFinished.emplace_back(workerPool->Submit([&action, &myChannelEpg]() { action(myChannelEpg); }));
+      for (auto& channelFinished : channelsFinished)
+        channelFinished.wait();
+    }
+    else
+    {
+      for (auto& myChannelEpg : m_channelEpgs)
+        action(myChannelEpg);
+    }
+  };
+
+  const size_t maxProgrammesPerChannel = Settings::GetInstance().GetEpgMaxProgrammesPerChannel();
+  const time_t now = std::time(nullptr);
+  std::atomic<size_t> removedCount{0};
+  forEachChannelEpg([maxProgrammesPerChannel, now, &removedCount](ChannelEpg& myChannelEpg)
+  {
+    myChannelEpg.SortEpgEntries();
+    myChannelEpg.SortLaterProgrammes();
+    if (maxProgrammesPerChannel > 0)
+      removedCount += myChannelEpg.LimitEpgEntries(maxProgrammesPerChannel, now);
+  });
+
+  m_laterProgrammeBytes = m_laterProgrammeData.size();
+  m_laterProgrammesFirstStart = FindFirstLaterProgrammeStart();
+
+  if (removedCount > 0)
+    Logger::Log(LEVEL_DEBUG, "%s - Removed %zu EPG entries over the limit of %zu per channel", __FUNCTION__, removedCount.load(), maxProgrammesPerChannel);
+
+  // In on demand mode there are no entries yet so there is nothing to share
+  if (!loadOnDemand)
+    ShareDuplicateChannelEpgEntries();
+
+  if (Settings::GetInstance().CompressEpgDescriptions() && !loadOnDemand)
+  {
+    // Channel EPGs sharing entries use the descriptions compressed for the one they share with
+    forEachChannelEpg([](ChannelEpg& myChannelEpg)
+    {
+      if (!myChannelEpg.SharesEpgEntries())
+        myChannelEpg.CompressEpgEntryDescriptions();
+    });
+
+    size_t descriptionBytes = 0;
+    size_t compressedDescriptionBytes = 0;
+    for (const auto& myChannelEpg : m_channelEpgs)
+    {
+      if (myChannelEpg.SharesEpgEntries())
+        continue;
+
+      descriptionBytes += myChannelEpg.GetDescriptionBytes();
+      compressedDescriptionBytes += myChannelEpg.GetCompressedDescriptionBytes();
+    }
 
-    xmlDoc.reset();
+    Logger::Log(LEVEL_DEBUG, "%s - Compressed %zu bytes of programme descriptions to %zu bytes", __FUNCTION__, descriptionBytes, compressedDescriptionBytes);
   }
+
+  if (loadOnDemand)
+    Logger::Log(LEVEL_INFO, "%s - Indexed '%d' EPG entries for %zu channels to be loaded on demand, retaining %zu bytes", __FUNCTION__,
+                count, m_deferredChannelCount, m_deferredProgrammeData.size());
   else
+    Logger::Log(LEVEL_INFO, "%s - Loaded '%d' EPG entries.", __FUNCTION__, count);
+
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Parsed %zu bytes with %zu channel and %zu programme elements in %d (ms) using %zu worker threads and %s scan kernels, max pending element data: %zu bytes",
+              __FUNCTION__, parser.GetBytesParsed(), parser.GetChannelElementCount(), parser.GetProgrammeElementCount(), milliseconds,
+              workerPool ? workerPool->GetThreadCount() : 0, ScanUtils::GetKernelName(), parser.GetMaxPendingLength());
+
+  Logger::Log(LEVEL_DEBUG, "%s - Kept %zu bytes of programmes after the EPG window to move it on with", __FUNCTION__, m_laterProgrammeData.size());
+
+  if (m_stringPool.GetInternCount() > 0)
+    Logger::Log(LEVEL_DEBUG, "%s - Interned %zu EPG strings with a %.1f%% hit rate, saving %zu bytes of text", __FUNCTION__,
+                m_stringPool.GetInternCount(), 100.0 * m_stringPool.GetHitCount() / m_stringPool.GetInternCount(), m_stringPool.GetBytesSaved());
+
+  return true;
+}
+
+void Epg::LoadChannelEpg(const XmltvElement& element, xml_document& xmlDoc)
+{
+  if (!XmltvParser::LoadElement(element, xmlDoc))
+    return;
+
+  ChannelEpg channelEpg;
+
+  if (channelEpg.UpdateFrom(xmlDoc.first_child(), m_channels, m_media))
+  {
+    ChannelEpg* existingChannelEpg = FindEpgForChannel(channelEpg.GetId());
+    if (existingChannelEpg)
+    {
+      if (existingChannelEpg->CombineNamesAndIconPathFrom(channelEpg))
+        Logger::Log(LEVEL_DEBUG, "%s - Combined channel EPG with id '%s' now has display names: '%s'", __FUNCTION__, channelEpg.GetId().c_str(), channelEpg.GetJoinedDisplayNames().c_str());
+
+      return;
+    }
+
+    Logger::Log(LEVEL_DEBUG, "%s - Loaded channel EPG with id '%s' with display names: '%s'", __FUNCTION__, channelEpg.GetId().c_str(), channelEpg.GetJoinedDisplayNames().c_str());
+
+    m_channelEpgIndex.AddId(channelEpg.GetId(), m_channelEpgs.size());
+
+    m_channelEpgs.emplace_back(channelEpg);
+  }
+}
+
+bool Epg::CheckChannelEpgsLoaded() const
+{
+  if (m_channelEpgs.size() == 0)
   {
+    Logger::Log(LEVEL_ERROR, "%s - EPG channels not found.", __FUNCTION__);
     return false;
   }
+  else
+  {
+    Logger::Log(LEVEL_INFO, "%s - Loaded '%d' EPG channels.", __FUNCTION__, m_channelEpgs.size());
+  }
 
-  LoadGenres();
+  return true;
+}
+
+void Epg::GetEpgShiftRange(int& minShiftTime, int& maxShiftTime) const
+{
+  minShiftTime = m_epgTimeShift;
+  maxShiftTime = m_epgTimeShift;
+  if (!m_tsOverride)
+  {
+    minShiftTime = SECONDS_IN_DAY;
+    maxShiftTime = -SECONDS_IN_DAY;
+
+    for (const auto& channel : m_channels.GetChannelsList())
+    {
+      if (channel.GetTvgShift() + m_epgTimeShift < minShiftTime)
+        minShiftTime = channel.GetTvgShift() + m_epgTimeShift;
+      if (channel.GetTvgShift() + m_epgTimeShift > maxShiftTime)
+        maxShiftTime = channel.GetTvgShift() + m_epgTimeShift;
+    }
+  }
+}
+
+bool Epg::FindEpgForProgramme(const XmltvElement& element, ChannelEpg*& channelEpg) const
+{
+  if (element.m_id.empty())
+    return false;
+
+  // Programmes are usually grouped by channel so the last channel EPG will mostly match
+  if (!channelEpg || !StringUtils::EqualsNoCase(channelEpg->GetId(), element.m_id))
+    channelEpg = FindEpgForChannel(element.m_id);
+
+  return channelEpg != nullptr;
+}
 
-  if (Settings::GetInstance().GetEpgLogosMode() != EpgLogosMode::IGNORE_XMLTV)
-    ApplyChannelsLogosFromEPG();
+bool Epg::LoadEpgEntry(const XmltvElement& element, xml_document& xmlDoc, ChannelEpg* channelEpg,
+                       time_t start, time_t end, int minShiftTime, int maxShiftTime) const
+{
+  if (!XmltvParser::LoadElement(element, xmlDoc))
+    return false;
+
+  EpgEntry entry;
+  if (entry.UpdateFrom(xmlDoc.first_child(), element.m_id, start, end, minShiftTime, maxShiftTime, m_stringPool))
+  {
+    channelEpg->AddEpgEntry(entry);
+    return true;
+  }
+
+  return false;
+}
+
+void Epg::ShareDuplicateChannelEpgEntries()
+{
+  // Anchor hash to the channel EPGs not sharing entries which have that programme, and its index
+  std::unordered_map<size_t, std::vector<std::pair<ChannelEpg*, size_t>>> candidateChannelEpgs;
+  std::vector<std::pair<size_t, size_t>> anchors;
+  int sharedCount = 0;
+
+  for (auto& myChannelEpg : m_channelEpgs)
+  {
+    const size_t epgEntryCount = myChannelEpg.GetEpgEntryCount();
+    if (epgEntryCount < MIN_SHARED_EPG_ENTRY_COUNT)
+      continue;
+
+    // The programmes with the lowest hashes are picked as anchors, a channel EPG with the same
+    // schedule will have the same anchors unless they fall outside of the part in common
+    anchors.clear();
+    for (size_t i = 0; i < epgEntryCount; i++)
+      anchors.emplace_back(HashProgramme(myChannelEpg.GetEpgEntry(i)), i);
+
+    const size_t anchorCount = std::min(SHARED_EPG_ANCHOR_COUNT, anchors.size());
+    std::partial_sort(anchors.begin(), anchors.begin() + anchorCount, anchors.end());
+
+    bool shared = false;
+    for (size_t i = 0; i < anchorCount && !shared; i++)
+    {
+      auto candidates = candidateChannelEpgs.find(anchors[i].first);
+      if (candidates == candidateChannelEpgs.end())
+        continue;
+
+      for (const auto& candidate : candidates->second)
+      {
+        // The offset is only a guess until every programme in common has been compared
+        const time_t offset = myChannelEpg.GetEpgEntryStartTime(anchors[i].second) - candidate.first->GetEpgEntryStartTime(candidate.second);
+        if (myChannelEpg.ShareEpgEntriesFrom(*candidate.first, offset))
+        {
+          Logger::Log(LEVEL_DEBUG, "%s - Channel EPG with id '%s' shares its entries with id '%s' offset by %lld seconds", __FUNCTION__,
+                      myChannelEpg.GetId().c_str(), candidate.first->GetId().c_str(), static_cast<long long>(offset));
+          shared = true;
+          sharedCount++;
+          break;
+        }
+      }
+    }
+
+    if (!shared)
+    {
+      for (size_t i = 0; i < anchorCount; i++)
+      {
+        auto& candidates = candidateChannelEpgs[anchors[i].first];
+        if (candidates.size() < MAX_SHARED_EPG_CANDIDATES)
+          candidates.emplace_back(&myChannelEpg, anchors[i].second);
+      }
+    }
+  }
+
+  if (sharedCount > 0)
+    Logger::Log(LEVEL_INFO, "%s - %d channel EPGs share their entries with another channel EPG", __FUNCTION__, sharedCount);
+}
+
+void Epg::LoadDeferredEpgEntries(ChannelEpg* channelEpg) const
+{
+  if (!channelEpg || !channelEpg->HasDeferredProgrammes())
+    return;
+
+  auto started = std::chrono::high_resolution_clock::now();
+
+  int count = ParseDeferredEpgEntries(*channelEpg);
 
   int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
                       std::chrono::high_resolution_clock::now() - started).count();
 
-  Logger::Log(LEVEL_INFO, "%s - EPG Loaded - %d (ms)", __FUNCTION__, milliseconds);
+  Logger::Log(LEVEL_DEBUG, "%s - Loaded '%d' EPG entries on demand for channel EPG with id '%s' in %d (ms)", __FUNCTION__, count, channelEpg->GetId().c_str(), milliseconds);
+
+  // Once every channel has been loaded the markup is no longer needed
+  if (--m_deferredChannelCount == 0)
+    ClearDeferredProgrammeData();
+}
+
+int Epg::ParseDeferredEpgEntries(ChannelEpg& channelEpg) const
+{
+  // Only touches the channel EPG itself, so different channel EPGs can be parsed at the same time
+  xml_document xmlDoc;
+  int count = 0;
+
+  XmltvParser parser([&](const XmltvElement& element)
+  {
+    if (LoadEpgEntry(element, xmlDoc, &channelEpg, m_deferredStart, m_deferredEnd, m_deferredMinShiftTime, m_deferredMaxShiftTime))
+      count++;
+
+    return true;
+  }, false);
+
+  for (const auto& programmes : channelEpg.GetDeferredProgrammes())
+    parser.Parse(&m_deferredProgrammeData[programmes.first], programmes.second);
+  parser.Finish();
+
+  channelEpg.SortEpgEntries();
+  if (Settings::GetInstance().GetEpgMaxProgrammesPerChannel() > 0)
+    channelEpg.LimitEpgEntries(Settings::GetInstance().GetEpgMaxProgrammesPerChannel(), std::time(nullptr));
+  if (Settings::GetInstance().CompressEpgDescriptions())
+    channelEpg.CompressEpgEntryDescriptions();
+  channelEpg.ClearDeferredProgrammes();
+
+  std::unordered_map<std::string, const EpgGenre*> resolvedGenreStrings;
+  ApplyGenreMappings(channelEpg, resolvedGenreStrings);
+
+  return count;
+}
+
+void Epg::ClearDeferredProgrammeData() const
+{
+  std::string().swap(m_deferredProgrammeData);
+  m_deferredChannelCount = 0;
+}
+
+void Epg::MoveLaterProgrammeDataFrom(Epg& epg)
+{
+  m_laterProgrammeData.swap(epg.m_laterProgrammeData);
+  m_laterProgrammeBytes = epg.m_laterProgrammeBytes;
+  m_laterProgrammesFrom = epg.m_laterProgrammesFrom;
+  m_laterProgrammesUntil = epg.m_laterProgrammesUntil;
+  m_laterProgrammesFirstStart = epg.m_laterProgrammesFirstStart;
+  m_laterMinShiftTime = epg.m_laterMinShiftTime;
+  m_laterMaxShiftTime = epg.m_laterMaxShiftTime;
+}
+
+void Epg::ClearLaterProgrammeData()
+{
+  std::string().swap(m_laterProgrammeData);
+  m_laterProgrammeBytes = 0;
+  m_laterProgrammesFrom = 0;
+  m_laterProgrammesUntil = 0;
+  m_laterProgrammesFirstStart = std::numeric_limits<time_t>::max();
+}
+
+time_t Epg::FindFirstLaterProgrammeStart()
+{
+  time_t firstStart = std::numeric_limits<time_t>::max();
+  for (auto& myChannelEpg : m_channelEpgs)
+  {
+    if (!myChannelEpg.GetLaterProgrammes().empty())
+      firstStart = std::min(firstStart, myChannelEpg.GetLaterProgrammes().front().m_startTime);
+  }
+
+  return firstStart;
+}
+
+void Epg::ReloadEPG()
+{
+  m_xmltvLocation = Settings::GetInstance().GetEpgLocation();
+  m_epgTimeShift = Settings::GetInstance().GetEpgTimeshiftSecs();
+  m_tsOverride = Settings::GetInstance().GetTsOverride();
+  m_loadWindow.Clear();
+
+  // What is loaded is kept until the new load is published, only the channels have changed
+  StopLoadingEPG();
+  IndexChannelEpgs();
+  ClearLiveEpgEntries();
+
+  // The whole EPG window is loaded so the requests Kodi makes once told to update the EPG and
+  // media, when the data is published, are covered rather than each starting another load
+  time_t now = std::time(nullptr);
+  LoadEPGForWindow(now - m_epgMaxPastDaysSeconds, now + m_epgMaxFutureDaysSeconds);
+}
+
+void Epg::LoadEPGForWindow(time_t start, time_t end)
+{
+  // Nothing to do if what is loaded, or being loaded, already covers the window
+  if (m_loadWindow.Covers(start, end))
+    return;
+
+  // A window moved on in time is extended with the programmes kept from the load if there are any,
+  // otherwise one only a little past the end is not worth loading the EPG again for
+  if (m_loadWindow.CoversStart(start) && (ExtendLoadedEPG(end) || m_loadWindow.CoversEndWithSlack(end)))
+    return;
+
+  // A single load covers the EPG window as well as what is asked for, and anything still to be
+  // loaded, so Kodi asking for the EPG of each channel in turn does not start loads of its own
+  const time_t now = std::time(nullptr);
+  start = std::min(start, now - m_epgMaxPastDaysSeconds);
+  end = std::max(end, now + m_epgMaxFutureDaysSeconds);
+  m_loadWindow.Widen(start, end);
+
+  // doesn't matter is epg loaded or not we shouldn't try to load it for same interval
+  m_loadWindow.Set(start, end);
+
+  LoadEPGInBackground(start, end);
+}
+
+bool Epg::ExtendLoadedEPG(time_t end)
+{
+  // Nothing is kept for a window which has been narrowed since, or past the programmes kept, nor is
+  // it used while loading
+  if (m_backgroundLoad || m_laterProgrammesFrom == 0 || m_loadWindow.GetEnd() < m_laterProgrammesFrom ||
+      end > m_laterProgrammesUntil)
+    return false;
+
+  // Until the window reaches the first programme kept there is nothing to parse, only its end moves on,
+  // so the calls of a guide update, each with an end a little later, do not go through every channel EPG
+  if (end - m_laterMinShiftTime < m_laterProgrammesFirstStart)
+  {
+    m_loadWindow.ExtendTo(end);
+    m_laterProgrammesFrom = m_loadWindow.GetEnd();
+    return true;
+  }
+
+  const time_t now = std::time(nullptr);
+  end = std::min(std::max(end, now + m_epgMaxFutureDaysSeconds), m_laterProgrammesUntil);
+
+  // Only the markup of the programmes the window moves over is taken here, it is parsed on a thread of its
+  // own and the entries published once it is done, as a load is, so Kodi is not kept waiting
+  std::unique_ptr<BackgroundLoad> backgroundLoad(new BackgroundLoad());
+  backgroundLoad->m_extension = true;
+  backgroundLoad->m_extendedFrom = m_loadWindow.GetEnd();
+  backgroundLoad->m_extensionStart = m_loadWindow.GetStart();
+  backgroundLoad->m_extensionEnd = end;
+  backgroundLoad->m_extensionMinShiftTime = m_laterMinShiftTime;
+  backgroundLoad->m_extensionMaxShiftTime = m_laterMaxShiftTime;
+
+  std::vector<ChannelEpg::LaterProgramme> programmes;
+  for (size_t i = 0; i < m_channelEpgs.size(); i++)
+  {
+    // Every programme kept starts after the old window for every shift, only those the new one reaches are parsed
+    if (!m_channelEpgs[i].TakeLaterProgrammes(end - m_laterMinShiftTime, programmes))
+      continue;
+
+    BackgroundLoad::ExtendedChannelEpg extendedChannelEpg;
+    extendedChannelEpg.m_channelEpgIndex = i;
+    for (const auto& programme : programmes)
+    {
+      extendedChannelEpg.m_programmeData.append(m_laterProgrammeData, programme.m_offset, programme.m_length);
+      m_laterProgrammeBytes -= programme.m_length;
+    }
+    backgroundLoad->m_extendedChannelEpgs.emplace_back(std::move(extendedChannelEpg));
+  }
+
+  // What is being loaded counts as loaded so the window is not extended, or loaded, again meanwhile
+  m_loadWindow.ExtendTo(end);
+  m_laterProgrammesFrom = end;
+  m_laterProgrammesFirstStart = FindFirstLaterProgrammeStart();
+
+  // Once over half of the markup kept has been taken the rest is moved up so the taken part can go
+  if (m_laterProgrammeBytes < m_laterProgrammeData.size() / 2)
+  {
+    std::string laterProgrammeData;
+    laterProgrammeData.reserve(m_laterProgrammeBytes);
+    for (auto& myChannelEpg : m_channelEpgs)
+    {
+      for (auto& programme : myChannelEpg.GetLaterProgrammes())
+      {
+        laterProgrammeData.append(m_laterProgrammeData, programme.m_offset, programme.m_length);
+        programme.m_offset = laterProgrammeData.size() - programme.m_length;
+      }
+    }
+    m_laterProgrammeData.swap(laterProgrammeData);
+  }
+
+  if (backgroundLoad->m_extendedChannelEpgs.empty())
+    return true;
+
+  m_backgroundLoad = std::move(backgroundLoad);
+
+  // Only what is const is used on the thread, the string pool and the genre mappings are safe to
+  // share as neither is cleared or replaced while an extension is running
+  BackgroundLoad* extension = m_backgroundLoad.get();
+  extension->m_thread = std::thread([this, extension]()
+  {
+    extension->m_loaded = LoadExtendedEpgEntries(*extension);
+    extension->m_finished = true;
+  });
+
+  Logger::Log(LEVEL_DEBUG, "%s - Started extending the EPG window in the background for %zu channel EPGs, %zu bytes of programmes after it are left",
+              __FUNCTION__, extension->m_extendedChannelEpgs.size(), m_laterProgrammeBytes);
+
+  return true;
+}
+
+bool Epg::LoadExtendedEpgEntries(BackgroundLoad& backgroundLoad) const
+{
+  auto started = std::chrono::high_resolution_clock::now();
+
+  xml_document xmlDoc;
+  std::unordered_map<std::string, const EpgGenre*> resolvedGenreStrings;
+  int count = 0;
+
+  for (auto& extendedChannelEpg : backgroundLoad.m_extendedChannelEpgs)
+  {
+    // The entries are loaded on their own first so those of channel EPGs sharing a store are added to it once
+    XmltvParser parser([&](const XmltvElement& element)
+    {
+      if (LoadEpgEntry(element, xmlDoc, &extendedChannelEpg.m_channelEpg, backgroundLoad.m_extensionStart, backgroundLoad.m_extensionEnd,
+                       backgroundLoad.m_extensionMinShiftTime, backgroundLoad.m_extensionMaxShiftTime))
+        count++;
+
+      return !backgroundLoad.m_extensionCancelled;
+    }, false);
+
+    parser.Parse(&extendedChannelEpg.m_programmeData[0], extendedChannelEpg.m_programmeData.size());
+    parser.Finish();
+    std::string().swap(extendedChannelEpg.m_programmeData);
+
+    if (backgroundLoad.m_extensionCancelled)
+    {
+      Logger::Log(LEVEL_DEBUG, "%s - Extending the EPG window cancelled", __FUNCTION__);
+      return false;
+    }
+
+    ApplyGenreMappings(extendedChannelEpg.m_channelEpg, resolvedGenreStrings);
+  }
+
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Loaded '%d' EPG entries to extend the EPG window in %d (ms)", __FUNCTION__, count, milliseconds);
+
+  return true;
+}
+
+void Epg::PublishExtendedEpgEntries(BackgroundLoad& backgroundLoad)
+{
+  if (!backgroundLoad.m_loaded)
+  {
+    DiscardExtendedEpgEntries(backgroundLoad);
+    return;
+  }
+
+  // Loading or clearing the EPG stops the extension first so its channel EPGs are where they were
+  const time_t now = std::time(nullptr);
+  const size_t maxProgrammesPerChannel = Settings::GetInstance().GetEpgMaxProgrammesPerChannel();
+  size_t limitedCount = 0;
+  std::vector<bool> extended(m_channelEpgs.size(), false);
+
+  for (auto& extendedChannelEpg : backgroundLoad.m_extendedChannelEpgs)
+  {
+    ChannelEpg& myChannelEpg = m_channelEpgs[extendedChannelEpg.m_channelEpgIndex];
+    myChannelEpg.AddLaterEpgEntriesFrom(extendedChannelEpg.m_channelEpg);
+
+    if (maxProgrammesPerChannel > 0)
+      limitedCount += myChannelEpg.LimitEpgEntries(maxProgrammesPerChannel, now);
+    if (Settings::GetInstance().CompressEpgDescriptions())
+      myChannelEpg.CompressEpgEntryDescriptions();
+
+    extended[extendedChannelEpg.m_channelEpgIndex] = true;
+  }
+
+  // Entries over the limit of a shared store are only freed once no channel EPG uses them
+  if (limitedCount > 0)
+    ChannelEpg::CompactEpgEntryStores(m_channelEpgs);
+
+  ClearLiveEpgEntries();
+
+  // The programmes the window has moved away from go as they would when pruned
+  PruneEpgEntries();
+
+  // Kodi asked for the window before its entries were there so is told about the channels which have them now
+  for (const auto& myChannel : m_channels.GetChannelsList())
+  {
+    auto channelEpg = m_channelEpgsByChannelUid.find(myChannel.GetUniqueId());
+    if (channelEpg != m_channelEpgsByChannelUid.end() && channelEpg->second &&
+        extended[channelEpg->second - m_channelEpgs.data()])
+      m_client->TriggerEpgUpdate(myChannel.GetUniqueId());
+  }
+
+  Logger::Log(LEVEL_DEBUG, "%s - Published the EPG entries extending the EPG window for %zu channel EPGs", __FUNCTION__,
+              backgroundLoad.m_extendedChannelEpgs.size());
+}
+
+void Epg::DiscardExtendedEpgEntries(BackgroundLoad& backgroundLoad)
+{
+  // The programmes taken for it are gone so the window goes back to where it was, and as the rest
+  // no longer follow on from it they go too
+  m_loadWindow.PruneTo(backgroundLoad.m_extendedFrom);
+  ClearLaterProgrammeData();
+  for (auto& myChannelEpg : m_channelEpgs)
+    myChannelEpg.ClearLaterProgrammes();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Discarded the EPG entries extending the EPG window", __FUNCTION__);
+}
+
+void Epg::LoadEPGInBackground(time_t start, time_t end)
+{
+  if (m_backgroundLoad)
+  {
+    m_loadPending = true;
+    m_pendingLoadStart = start;
+    m_pendingLoadEnd = end;
+    return;
+  }
+
+  // Only what loading reads from this Epg is needed, the rest is moved back on publishing
+  std::unique_ptr<Epg> epg(new Epg(m_client, m_channels, m_channelGroups, m_media));
+  epg->m_xmltvLocation = m_xmltvLocation;
+  epg->m_epgTimeShift = m_epgTimeShift;
+  epg->m_tsOverride = m_tsOverride;
+
+  m_backgroundLoad.reset(new BackgroundLoad());
+  m_backgroundLoad->m_epg = std::move(epg);
+  m_loadState = EpgLoadState::LOADING;
+
+  if (Settings::GetInstance().GetEpgLoadMode() == EpgLoadMode::PROGRESSIVE)
+  {
+    m_backgroundLoad->m_progressive = true;
+    m_backgroundLoad->m_channelUidsByPriority = GetChannelUidsByPriority();
+    m_backgroundLoad->m_playingChannelUid = m_playingChannelUid;
+  }
+
+  BackgroundLoad* backgroundLoad = m_backgroundLoad.get();
+  backgroundLoad->m_thread = std::thread([backgroundLoad, start, end]()
+  {
+    backgroundLoad->m_loaded = backgroundLoad->m_epg->LoadEPG(start, end);
+    if (backgroundLoad->m_loaded && backgroundLoad->m_progressive)
+      backgroundLoad->m_loaded = backgroundLoad->m_epg->LoadEpgEntriesByPriority(*backgroundLoad);
+    backgroundLoad->m_finished = true;
+  });
+
+  Logger::Log(LEVEL_DEBUG, "%s - Started loading EPG in the background", __FUNCTION__);
+}
+
+void Epg::PublishLoadedEPG()
+{
+  if (!m_backgroundLoad)
+    return;
+
+  const bool finished = m_backgroundLoad->m_finished;
+  if (finished)
+    m_backgroundLoad->m_thread.join();
+
+  // Channels loaded progressively are published as they are ready, not only once all are
+  if (m_backgroundLoad->m_progressive)
+    PublishLoadedChannelEpgs(*m_backgroundLoad);
+
+  if (!finished)
+    return;
+
+  std::unique_ptr<BackgroundLoad> backgroundLoad = std::move(m_backgroundLoad);
+
+  if (backgroundLoad->m_extension)
+  {
+    PublishExtendedEpgEntries(*backgroundLoad);
+  }
+  else if (backgroundLoad->m_loaded)
+  {
+    if (backgroundLoad->m_progressive)
+    {
+      // Every channel EPG and its entries have already been published
+      m_genreMappings.swap(backgroundLoad->m_epg->m_genreMappings);
+      m_genreMappingsByName.swap(backgroundLoad->m_epg->m_genreMappingsByName);
+      MoveLaterProgrammeDataFrom(*backgroundLoad->m_epg);
+    }
+    else
+    {
+      MoveLoadedEpgFrom(*backgroundLoad->m_epg);
 
-  return true;
-}
+      if (Settings::GetInstance().GetEpgLogosMode() != EpgLogosMode::IGNORE_XMLTV)
+        ApplyChannelsLogosFromEPG();
 
-bool Epg::GetXMLTVFileWithRetries(std::string& data)
-{
-  int bytesRead = 0;
-  int count = 0;
+      for (const auto& myChannel : m_channels.GetChannelsList())
+        m_client->TriggerEpgUpdate(myChannel.GetUniqueId());
+    }
 
-  // Cache is only allowed if refresh mode is disabled
-  bool useEPGCache = Settings::GetInstance().GetM3URefreshMode() != RefreshMode::DISABLED ? false : Settings::GetInstance().UseEPGCache();
+    m_loadState = EpgLoadState::READY;
 
-  while (count < 3) // max 3 tries
-  {
-    if ((bytesRead = FileUtils::GetCachedFileContents(XMLTV_CACHE_FILENAME, m_xmltvLocation, data, useEPGCache)) != 0)
-      break;
+    MergeEpgDataIntoMedia();
 
-    Logger::Log(LEVEL_ERROR, "%s - Unable to load EPG file '%s':  file is missing or empty. :%dth try.", __FUNCTION__, m_xmltvLocation.c_str(), ++count);
+    m_client->TriggerRecordingUpdate();
 
-    if (count < 3)
-      std::this_thread::sleep_for(std::chrono::microseconds(2 * 1000 * 1000)); // sleep 2 sec before next try.
+    Logger::Log(LEVEL_DEBUG, "%s - Published EPG loaded in the background", __FUNCTION__);
   }
-
-  if (bytesRead == 0)
+  else
   {
-    Logger::Log(LEVEL_ERROR, "%s - Unable to load EPG file '%s':  file is missing or empty. After %d tries.", __FUNCTION__, m_xmltvLocation.c_str(), count);
-    return false;
+    // Whatever was loaded before is kept
+    m_loadState = m_channelEpgs.empty() ? EpgLoadState::NOT_LOADED : EpgLoadState::READY;
   }
 
-  return true;
+  if (m_loadPending)
+  {
+    m_loadPending = false;
+    LoadEPGInBackground(m_pendingLoadStart, m_pendingLoadEnd);
+  }
 }
 
-char* Epg::FillBufferFromXMLTVData(std::string& data, std::string& decompressedData)
+void Epg::PublishLoadedChannelEpgs(BackgroundLoad& backgroundLoad)
 {
-  char* buffer = nullptr;
-
-  // gzip packed
-  if (data[0] == '\x1F' && data[1] == '\x8B' && data[2] == '\x08')
+  std::vector<ChannelEpg> channelEpgsWithoutEntries;
+  ChannelEpgIndex channelEpgIndex;
+  std::vector<size_t> loadedChannelEpgIndexes;
   {
-    if (!FileUtils::GzipInflate(data, decompressedData))
-    {
-      Logger::Log(LEVEL_ERROR, "%s - Invalid EPG file '%s': unable to decompress gzip file.", __FUNCTION__, m_xmltvLocation.c_str());
-      return nullptr;
-    }
-    buffer = &(decompressedData[0]);
+    std::lock_guard<std::mutex> lock(backgroundLoad.m_mutex);
+    if (!backgroundLoad.m_channelEpgsLoaded)
+      return;
+
+    channelEpgsWithoutEntries.swap(backgroundLoad.m_channelEpgsWithoutEntries);
+    std::swap(channelEpgIndex, backgroundLoad.m_channelEpgIndex);
+    loadedChannelEpgIndexes.swap(backgroundLoad.m_loadedChannelEpgIndexes);
   }
-  // xz packed
-  else if (data[0] == '\xFD' && data[1] == '7' && data[2] == 'z' &&
-           data[3] == 'X' && data[4] == 'Z' && data[5] == '\x00')
+
+  if (!backgroundLoad.m_channelEpgsPublished)
   {
-    if (!FileUtils::XzDecompress(data, decompressedData))
-    {
-      Logger::Log(LEVEL_ERROR, "%s - Invalid EPG file '%s': unable to decompress xz/7z file.", __FUNCTION__, m_xmltvLocation.c_str());
-      return nullptr;
-    }
-    buffer = &(decompressedData[0]);
+    backgroundLoad.m_channelEpgsPublished = true;
+
+    // What was loaded before goes, the entries of each channel EPG follow as they are loaded
+    m_channelEpgs.swap(channelEpgsWithoutEntries);
+    std::swap(m_channelEpgIndex, channelEpgIndex);
+    IndexChannelEpgs();
+    m_genreMappings.clear();
+    m_genreMappingsByName.clear();
+    m_stringPool.Clear();
+    ClearDeferredProgrammeData();
+    m_deferredStart = 0;
+    m_deferredEnd = 0;
+    ClearLaterProgrammeData();
+    ClearLiveEpgEntries();
+
+    if (Settings::GetInstance().GetEpgLogosMode() != EpgLogosMode::IGNORE_XMLTV)
+      ApplyChannelsLogosFromEPG();
+
+    Logger::Log(LEVEL_DEBUG, "%s - Published %zu channel EPGs, their entries are published as they are loaded", __FUNCTION__, m_channelEpgs.size());
   }
-  else
+
+  if (loadedChannelEpgIndexes.empty())
+    return;
+
+  // The loading thread no longer touches a channel EPG once handed over, the indexes are the same in both
+  std::vector<bool> published(m_channelEpgs.size(), false);
+  for (size_t index : loadedChannelEpgIndexes)
   {
-    buffer = &(data[0]);
+    m_channelEpgs[index] = std::move(backgroundLoad.m_epg->m_channelEpgs[index]);
+    published[index] = true;
   }
 
-  XmltvFileFormat fileFormat = GetXMLTVFileFormat(buffer);
+  // Rows for channels without entries until now would otherwise never be updated
+  ClearLiveEpgEntries();
 
-  if (fileFormat == XmltvFileFormat::INVALID)
+  // Kodi is only told about the channels in this batch, in order so the guide fills in from the top
+  for (int channelUid : backgroundLoad.m_channelUidsByPriority)
   {
-    Logger::Log(LEVEL_ERROR, "%s - Invalid EPG file '%s': unable to parse file.", __FUNCTION__, m_xmltvLocation.c_str());
-    return nullptr;
+    auto channelEpg = m_channelEpgsByChannelUid.find(channelUid);
+    if (channelEpg != m_channelEpgsByChannelUid.end() && channelEpg->second &&
+        published[channelEpg->second - m_channelEpgs.data()])
+      m_client->TriggerEpgUpdate(channelUid);
   }
 
-  if (fileFormat == XmltvFileFormat::TAR_ARCHIVE)
-    buffer += 0x200; // RECORDSIZE = 512
-
-  return buffer;
+  Logger::Log(LEVEL_DEBUG, "%s - Published the entries of %zu channel EPGs", __FUNCTION__, loadedChannelEpgIndexes.size());
 }
 
-const XmltvFileFormat Epg::GetXMLTVFileFormat(const char* buffer)
+bool Epg::LoadEpgEntriesByPriority(BackgroundLoad& backgroundLoad)
 {
-  if (!buffer)
-    return XmltvFileFormat::INVALID;
+  auto started = std::chrono::high_resolution_clock::now();
+
+  // The channel EPGs are published first so their entries can be handed over by index once loaded
+  // Their programmes after the window are kept, the markup for them is handed over once loaded
+  std::vector<ChannelEpg> channelEpgsWithoutEntries = m_channelEpgs;
+  for (auto& channelEpg : channelEpgsWithoutEntries)
+    channelEpg.ClearDeferredProgrammes();
 
-  // xml should starts with '<?xml'
-  if (buffer[0] != '\x3C' || buffer[1] != '\x3F' || buffer[2] != '\x78' ||
-      buffer[3] != '\x6D' || buffer[4] != '\x6C')
   {
-    // check for BOM
-    if (buffer[0] != '\xEF' || buffer[1] != '\xBB' || buffer[2] != '\xBF')
+    std::lock_guard<std::mutex> lock(backgroundLoad.m_mutex);
+    backgroundLoad.m_channelEpgsWithoutEntries.swap(channelEpgsWithoutEntries);
+    backgroundLoad.m_channelEpgIndex = m_channelEpgIndex;
+    backgroundLoad.m_channelEpgsLoaded = true;
+  }
+
+  auto findChannelEpgIndex = [this](int channelUid)
+  {
+    auto channelEpg = m_channelEpgsByChannelUid.find(channelUid);
+    if (channelEpg == m_channelEpgsByChannelUid.end() || !channelEpg->second)
+      return NO_CHANNEL_EPG_INDEX;
+
+    return static_cast<size_t>(channelEpg->second - m_channelEpgs.data());
+  };
+
+  // Channel EPGs without programmes have nothing to load, those for no channel, e.g. for media, come last
+  std::vector<bool> queued(m_channelEpgs.size(), false);
+  std::vector<size_t> channelEpgIndexes;
+  for (size_t i = 0; i < m_channelEpgs.size(); i++)
+    queued[i] = !m_channelEpgs[i].HasDeferredProgrammes();
+  for (int channelUid : backgroundLoad.m_channelUidsByPriority)
+  {
+    const size_t index = findChannelEpgIndex(channelUid);
+    if (index != NO_CHANNEL_EPG_INDEX && !queued[index])
     {
-      // check for tar archive
-      if (strcmp(buffer + 0x101, "ustar") || strcmp(buffer + 0x101, "GNUtar"))
-        return XmltvFileFormat::TAR_ARCHIVE;
-      else
-        return XmltvFileFormat::INVALID;
+      queued[index] = true;
+      channelEpgIndexes.emplace_back(index);
     }
   }
+  for (size_t i = 0; i < m_channelEpgs.size(); i++)
+  {
+    if (!queued[i])
+      channelEpgIndexes.emplace_back(i);
+  }
 
-  return XmltvFileFormat::NORMAL;
-}
+  WorkerPool workerPool(WorkerPool::GetDefaultThreadCount());
+  std::vector<bool> loaded(m_channelEpgs.size(), false);
+  std::vector<size_t> batch;
+  std::vector<std::future<void>> batchParsed;
+  std::atomic<int> count{0};
+  size_t next = 0;
 
-bool Epg::LoadChannelEpgs(const xml_node& rootElement)
-{
-  if (!rootElement)
-    return false;
+  while (!m_loadCancelled)
+  {
+    batch.clear();
 
-  m_channelEpgs.clear();
+    // A channel which starts playing while loading is loaded next
+    int playingChannelUid;
+    {
+      std::lock_guard<std::mutex> lock(backgroundLoad.m_mutex);
+      playingChannelUid = backgroundLoad.m_playingChannelUid;
+    }
 
-  for (const auto& channelNode : rootElement.children("channel"))
-  {
-    ChannelEpg channelEpg;
+    const size_t playingIndex = findChannelEpgIndex(playingChannelUid);
+    if (playingIndex != NO_CHANNEL_EPG_INDEX && !loaded[playingIndex] && m_channelEpgs[playingIndex].HasDeferredProgrammes())
+    {
+      loaded[playingIndex] = true;
+      batch.emplace_back(playingIndex);
+    }
 
-    if (channelEpg.UpdateFrom(channelNode, m_channels, m_media))
+    while (batch.size() < PRIORITY_LOAD_BATCH_SIZE && next < channelEpgIndexes.size())
     {
-      ChannelEpg* existingChannelEpg = FindEpgForChannel(channelEpg.GetId());
-      if (existingChannelEpg)
+      const size_t index = channelEpgIndexes[next++];
+      if (!loaded[index])
       {
-        if (existingChannelEpg->CombineNamesAndIconPathFrom(channelEpg))
-          Logger::Log(LEVEL_DEBUG, "%s - Combined channel EPG with id '%s' now has display names: '%s'", __FUNCTION__, channelEpg.GetId().c_str(), channelEpg.GetJoinedDisplayNames().c_str());
-
-        continue;
+        loaded[index] = true;
+        batch.emplace_back(index);
       }
+    }
 
-      Logger::Log(LEVEL_DEBUG, "%s - Loaded channel EPG with id '%s' with display names: '%s'", __FUNCTION__, channelEpg.GetId().c_str(), channelEpg.GetJoinedDisplayNames().c_str());
+    if (batch.empty())
+      break;
 
-      m_channelEpgs.emplace_back(channelEpg);
+    batchParsed.clear();
+    for (size_t index : batch)
+    {
+      ChannelEpg& channelEpg = m_channelEpgs[index];
+      batchParsed.emplace_back(workerPool.Submit([this, &channelEpg, &count]() { count += ParseDeferredEpgEntries(channelEpg); }));
     }
+    for (auto& parsed : batchParsed)
+      parsed.wait();
+
+    std::lock_guard<std::mutex> lock(backgroundLoad.m_mutex);
+    backgroundLoad.m_loadedChannelEpgIndexes.insert(backgroundLoad.m_loadedChannelEpgIndexes.end(), batch.begin(), batch.end());
   }
 
-  if (m_channelEpgs.size() == 0)
-  {
-    Logger::Log(LEVEL_ERROR, "%s - EPG channels not found.", __FUNCTION__);
+  ClearDeferredProgrammeData();
+
+  if (m_loadCancelled)
     return false;
-  }
-  else
-  {
-    Logger::Log(LEVEL_INFO, "%s - Loaded '%d' EPG channels.", __FUNCTION__, m_channelEpgs.size());
-  }
+
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_INFO, "%s - Loaded '%d' EPG entries for %zu channel EPGs by priority in %d (ms)", __FUNCTION__,
+              count.load(), channelEpgIndexes.size(), milliseconds);
 
   return true;
 }
 
-void Epg::LoadEpgEntries(const xml_node& rootElement, int start, int end)
+std::vector<int> Epg::GetChannelUidsByPriority() const
 {
-  int minShiftTime = m_epgTimeShift;
-  int maxShiftTime = m_epgTimeShift;
-  if (!m_tsOverride)
-  {
-    minShiftTime = SECONDS_IN_DAY;
-    maxShiftTime = -SECONDS_IN_DAY;
+  const auto& channels = m_channels.GetChannelsList();
 
-    for (const auto& channel : m_channels.GetChannelsList())
+  // Each channel is ordered by the first group it is in, those in no group come last
+  std::vector<size_t> groupOrders(channels.size(), std::numeric_limits<size_t>::max());
+  const auto& channelGroups = m_channelGroups.GetChannelGroupsList();
+  for (size_t i = 0; i < channelGroups.size(); i++)
+  {
+    for (int channelIndex : channelGroups[i].GetMemberChannelIndexes())
     {
-      if (channel.GetTvgShift() + m_epgTimeShift < minShiftTime)
-        minShiftTime = channel.GetTvgShift() + m_epgTimeShift;
-      if (channel.GetTvgShift() + m_epgTimeShift > maxShiftTime)
-        maxShiftTime = channel.GetTvgShift() + m_epgTimeShift;
+      if (channelIndex >= 0 && static_cast<size_t>(channelIndex) < channels.size())
+        groupOrders[channelIndex] = std::min(groupOrders[channelIndex], i);
     }
   }
 
-  ChannelEpg* channelEpg = nullptr;
-  int count = 0;
+  std::vector<size_t> channelIndexes(channels.size());
+  for (size_t i = 0; i < channelIndexes.size(); i++)
+    channelIndexes[i] = i;
 
-  for (const auto& programmeNode : rootElement.children("programme"))
+  std::stable_sort(channelIndexes.begin(), channelIndexes.end(), [&](size_t left, size_t right)
   {
-    std::string id;
-    if (!GetAttributeValue(programmeNode, "channel", id))
-      continue;
+    if (groupOrders[left] != groupOrders[right])
+      return groupOrders[left] < groupOrders[right];
+    if (channels[left].GetChannelNumber() != channels[right].GetChannelNumber())
+      return channels[left].GetChannelNumber() < channels[right].GetChannelNumber();
+    return channels[left].GetSubChannelNumber() < channels[right].GetSubChannelNumber();
+  });
+
+  // The channel playing comes before all of them
+  std::vector<int> channelUids;
+  if (m_playingChannelUid != -1)
+    channelUids.emplace_back(m_playingChannelUid);
+  for (size_t channelIndex : channelIndexes)
+  {
+    if (channels[channelIndex].GetUniqueId() != m_playingChannelUid)
+      channelUids.emplace_back(channels[channelIndex].GetUniqueId());
+  }
 
-    if (!channelEpg || !StringUtils::EqualsNoCase(channelEpg->GetId(), id))
-    {
-      if (!(channelEpg = FindEpgForChannel(id)))
-        continue;
-    }
+  return channelUids;
+}
 
-    EpgEntry entry;
-    if (entry.UpdateFrom(programmeNode, id, start, end, minShiftTime, maxShiftTime))
-    {
-      count++;
+void Epg::SetPlayingChannel(int channelUid)
+{
+  m_playingChannelUid = channelUid;
 
-      channelEpg->AddEpgEntry(entry);
-    }
+  // A progressive load in progress loads its EPG next
+  if (m_backgroundLoad && m_backgroundLoad->m_progressive)
+  {
+    std::lock_guard<std::mutex> lock(m_backgroundLoad->m_mutex);
+    m_backgroundLoad->m_playingChannelUid = channelUid;
   }
+}
+
+void Epg::CancelLoadingEPG()
+{
+  m_loadPending = false;
 
-  Logger::Log(LEVEL_INFO, "%s - Loaded '%d' EPG entries.", __FUNCTION__, count);
+  // Parsing stops at the next element and a download at the next buffer read
+  if (m_backgroundLoad && m_backgroundLoad->m_extension)
+    m_backgroundLoad->m_extensionCancelled = true;
+  else if (m_backgroundLoad)
+    m_backgroundLoad->m_epg->m_loadCancelled = true;
 }
 
+void Epg::WaitForCancelledLoad()
+{
+  // Called without the client lock held, only the thread which publishes loads ever replaces
+  // the background load so it stays put while this waits for it
+  if (m_backgroundLoad && m_backgroundLoad->m_thread.joinable())
+    m_backgroundLoad->m_thread.join();
+}
 
-void Epg::ReloadEPG()
+void Epg::StopLoadingEPG()
 {
-  m_xmltvLocation = Settings::GetInstance().GetEpgLocation();
-  m_epgTimeShift = Settings::GetInstance().GetEpgTimeshiftSecs();
-  m_tsOverride = Settings::GetInstance().GetTsOverride();
-  m_lastStart = 0;
-  m_lastEnd = 0;
+  CancelLoadingEPG();
 
-  Clear();
+  if (!m_backgroundLoad)
+    return;
 
-  if (LoadEPG(m_lastStart, m_lastEnd))
-  {
-    MergeEpgDataIntoMedia();
+  if (m_backgroundLoad->m_thread.joinable())
+    m_backgroundLoad->m_thread.join();
+  if (m_backgroundLoad->m_extension)
+    DiscardExtendedEpgEntries(*m_backgroundLoad);
+  m_backgroundLoad.reset();
 
-    for (const auto& myChannel : m_channels.GetChannelsList())
-      m_client->TriggerEpgUpdate(myChannel.GetUniqueId());
+  if (m_loadState == EpgLoadState::LOADING)
+    m_loadState = m_channelEpgs.empty() ? EpgLoadState::NOT_LOADED : EpgLoadState::READY;
 
-    m_client->TriggerRecordingUpdate();
-  }
+  Logger::Log(LEVEL_DEBUG, "%s - Stopped loading EPG in the background", __FUNCTION__);
+}
+
+void Epg::MoveLoadedEpgFrom(Epg& epg)
+{
+  // Swapping the vectors keeps their elements where they are so the indexes still point at them
+  m_channelEpgs.swap(epg.m_channelEpgs);
+  std::swap(m_channelEpgIndex, epg.m_channelEpgIndex);
+  m_channelEpgsByChannelUid.swap(epg.m_channelEpgsByChannelUid);
+  m_genreMappings.swap(epg.m_genreMappings);
+  m_genreMappingsByName.swap(epg.m_genreMappingsByName);
+
+  m_deferredProgrammeData.swap(epg.m_deferredProgrammeData);
+  m_deferredChannelCount = epg.m_deferredChannelCount;
+  m_deferredStart = epg.m_deferredStart;
+  m_deferredEnd = epg.m_deferredEnd;
+  m_deferredMinShiftTime = epg.m_deferredMinShiftTime;
+  m_deferredMaxShiftTime = epg.m_deferredMaxShiftTime;
+  MoveLaterProgrammeDataFrom(epg);
+
+  // The loaded entries keep the strings they share, entries loaded on demand from now on share their own
+  m_stringPool.Clear();
+  ClearLiveEpgEntries();
 }
 
 PVR_ERROR Epg::GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::addon::PVREPGTagsResultSet& results)
@@ -358,38 +1596,36 @@ PVR_ERROR Epg::GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::
     if (myChannel.GetUniqueId() != channelUid)
       continue;
 
-    if (start > m_lastStart || end > m_lastEnd)
-    {
-      // reload EPG for new time interval only
-      LoadEPG(start, end);
-      {
-        MergeEpgDataIntoMedia();
-
-        // doesn't matter is epg loaded or not we shouldn't try to load it for same interval
-        m_lastStart = static_cast<int>(start);
-        m_lastEnd = static_cast<int>(end);
-      }
-    }
+    // reload EPG for new time interval only, what is already loaded is returned until then
+    LoadEPGForWindow(start, end);
 
     ChannelEpg* channelEpg = FindEpgForChannel(myChannel);
-    if (!channelEpg || channelEpg->GetEpgEntries().size() == 0)
+    LoadDeferredEpgEntries(channelEpg);
+    if (!channelEpg || channelEpg->GetEpgEntryCount() == 0)
+    {
+      if (m_loadState == EpgLoadState::LOADING)
+        Logger::Log(LEVEL_DEBUG, "%s - EPG for channel '%s' is not available until loading finishes", __FUNCTION__, myChannel.GetChannelName().c_str());
       return PVR_ERROR_NO_ERROR;
+    }
 
     int shift = GetEPGTimezoneShiftSecs(myChannel);
 
-    for (auto& epgEntryPair : channelEpg->GetEpgEntries())
+    // A single tag is reused for the whole batch so its string buffers are only allocated
+    // for the first few entries. UpdateTo() sets each field it sets for any entry whichever
+    // branch it takes, e.g. the genre sub type, so nothing carries over from the entry before
+    kodi::addon::PVREPGTag tag;
+
+    const size_t epgEntryCount = channelEpg->GetEpgEntryCount();
+    for (size_t i = channelEpg->FindFirstEpgEntryEndingAfter(start, shift); i < epgEntryCount; i++)
     {
-      auto& epgEntry = epgEntryPair.second;
-      if ((epgEntry.GetEndTime() + shift) < start)
+      if ((channelEpg->GetEpgEntryEndTime(i) + shift) < start)
         continue;
 
-      kodi::addon::PVREPGTag tag;
-
-      epgEntry.UpdateTo(tag, channelUid, shift, m_genreMappings);
+      channelEpg->UpdateEpgEntryTo(i, tag, channelUid, shift);
 
       results.Add(tag);
 
-      if ((epgEntry.GetStartTime() + shift) > end)
+      if ((channelEpg->GetEpgEntryStartTime(i) + shift) > end)
         break;
     }
 
@@ -399,76 +1635,68 @@ PVR_ERROR Epg::GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::
   return PVR_ERROR_NO_ERROR;
 }
 
-ChannelEpg* Epg::FindEpgForChannel(const std::string& id) const
+void Epg::IndexChannelEpgs()
 {
-  for (auto& myChannelEpg : m_channelEpgs)
+  auto started = std::chrono::high_resolution_clock::now();
+
+  m_channelEpgIndex.ClearDisplayNames();
+  m_channelEpgsByChannelUid.clear();
+
+  // Indexed in order so the first channel EPG with a display name is found, as when searching
+  for (size_t i = 0; i < m_channelEpgs.size(); i++)
   {
-    if (StringUtils::EqualsNoCase(myChannelEpg.GetId(), id))
-      return const_cast<ChannelEpg*>(&myChannelEpg);
+    for (const DisplayNamePair& displayNamePair : m_channelEpgs[i].GetDisplayNames())
+      m_channelEpgIndex.AddDisplayName(displayNamePair.m_displayName, displayNamePair.m_displayNameWithUnderscores, i);
   }
 
-  return nullptr;
+  // The channels only change along with the EPG so each one is bound to its channel EPG once
+  for (const auto& channel : m_channels.GetChannelsList())
+    m_channelEpgsByChannelUid[channel.GetUniqueId()] = FindEpgForNames(channel.GetTvgId(), channel.GetTvgName(), channel.GetChannelName());
+
+  int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+                      std::chrono::high_resolution_clock::now() - started).count();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Indexed %zu channel EPGs by %zu display names and bound %zu channels in %d (ms)", __FUNCTION__,
+              m_channelEpgs.size(), m_channelEpgIndex.GetDisplayNameCount(), m_channelEpgsByChannelUid.size(), milliseconds);
 }
 
-ChannelEpg* Epg::FindEpgForChannel(const Channel& channel) const
+void Epg::ClearChannelEpgIndexes()
 {
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    if (StringUtils::EqualsNoCase(myChannelEpg.GetId(), channel.GetTvgId()))
-      return const_cast<ChannelEpg*>(&myChannelEpg);
-  }
-
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    for (const DisplayNamePair& displayNamePair : myChannelEpg.GetDisplayNames())
-    {
-      if (StringUtils::EqualsNoCase(displayNamePair.m_displayNameWithUnderscores, channel.GetTvgName()) ||
-          StringUtils::EqualsNoCase(displayNamePair.m_displayName, channel.GetTvgName()))
-        return const_cast<ChannelEpg*>(&myChannelEpg);
-    }
-  }
+  m_channelEpgIndex.Clear();
+  m_channelEpgsByChannelUid.clear();
+}
 
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    for (const DisplayNamePair& displayNamePair : myChannelEpg.GetDisplayNames())
-    {
-      if (StringUtils::EqualsNoCase(displayNamePair.m_displayName, channel.GetChannelName()))
-        return const_cast<ChannelEpg*>(&myChannelEpg);
-    }
-  }
+ChannelEpg* Epg::FindEpgForChannel(const std::string& id) const
+{
+  size_t channelEpgIndex;
+  if (!m_channelEpgIndex.FindById(id, channelEpgIndex))
+    return nullptr;
 
-  return nullptr;
+  return const_cast<ChannelEpg*>(&m_channelEpgs[channelEpgIndex]);
 }
 
-ChannelEpg* Epg::FindEpgForMediaEntry(const MediaEntry& mediaEntry) const
+ChannelEpg* Epg::FindEpgForChannel(const Channel& channel) const
 {
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    if (StringUtils::EqualsNoCase(myChannelEpg.GetId(), mediaEntry.GetTvgId()))
-      return const_cast<ChannelEpg*>(&myChannelEpg);
-  }
+  auto channelEpg = m_channelEpgsByChannelUid.find(channel.GetUniqueId());
+  if (channelEpg != m_channelEpgsByChannelUid.end())
+    return channelEpg->second;
 
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    for (const DisplayNamePair& displayNamePair : myChannelEpg.GetDisplayNames())
-    {
-      if (StringUtils::EqualsNoCase(displayNamePair.m_displayNameWithUnderscores, mediaEntry.GetTvgName()) ||
-          StringUtils::EqualsNoCase(displayNamePair.m_displayName, mediaEntry.GetTvgName()))
-        return const_cast<ChannelEpg*>(&myChannelEpg);
-    }
-  }
+  return FindEpgForNames(channel.GetTvgId(), channel.GetTvgName(), channel.GetChannelName());
+}
 
+ChannelEpg* Epg::FindEpgForMediaEntry(const MediaEntry& mediaEntry) const
+{
   // Note that prior to merging EPG data a media entries title will be the same a a channels name.
-  for (auto& myChannelEpg : m_channelEpgs)
-  {
-    for (const DisplayNamePair& displayNamePair : myChannelEpg.GetDisplayNames())
-    {
-      if (StringUtils::EqualsNoCase(displayNamePair.m_displayName, mediaEntry.GetM3UName()))
-        return const_cast<ChannelEpg*>(&myChannelEpg);
-    }
-  }
+  return FindEpgForNames(mediaEntry.GetTvgId(), mediaEntry.GetTvgName(), mediaEntry.GetM3UName());
+}
 
-  return nullptr;
+ChannelEpg* Epg::FindEpgForNames(const std::string& tvgId, const std::string& tvgName, const std::string& displayName) const
+{
+  size_t channelEpgIndex;
+  if (!m_channelEpgIndex.FindByNames(tvgId, tvgName, displayName, channelEpgIndex))
+    return nullptr;
+
+  return const_cast<ChannelEpg*>(&m_channelEpgs[channelEpgIndex]);
 }
 
 void Epg::ApplyChannelsLogosFromEPG()
@@ -509,6 +1737,7 @@ bool Epg::LoadGenres()
     return false;
 
   m_genreMappings.clear();
+  m_genreMappingsByName.clear();
 
   char* buffer = &(data[0]);
   xml_document xmlDoc;
@@ -536,12 +1765,59 @@ bool Epg::LoadGenres()
 
   xmlDoc.reset();
 
+  // Where a genre string is mapped more than once the first mapping is used
+  for (const auto& genreMapping : m_genreMappings)
+  {
+    std::string genreString = genreMapping.GetGenreString();
+    StringUtils::ToLower(genreString);
+    m_genreMappingsByName.emplace(genreString, &genreMapping);
+  }
+
   if (!m_genreMappings.empty())
     Logger::Log(LEVEL_INFO, "%s - Loaded %d genres", __FUNCTION__, m_genreMappings.size());
 
   return true;
 }
 
+const EpgGenre* Epg::FindGenreMapping(const std::string& genreString) const
+{
+  if (m_genreMappingsByName.empty())
+    return nullptr;
+
+  // The first category with a mapping is used
+  for (auto& genre : StringUtils::Split(genreString, EPG_STRING_TOKEN_SEPARATOR))
+  {
+    if (genre.empty())
+      continue;
+
+    StringUtils::ToLower(genre);
+    auto genreMapping = m_genreMappingsByName.find(genre);
+    if (genreMapping != m_genreMappingsByName.end())
+      return genreMapping->second;
+  }
+
+  return nullptr;
+}
+
+void Epg::ApplyGenreMappings(ChannelEpg& channelEpg, std::unordered_map<std::string, const EpgGenre*>& resolvedGenreStrings) const
+{
+  if (m_genreMappingsByName.empty())
+    return;
+
+  for (size_t i = 0; i < channelEpg.GetEpgEntryCount(); i++)
+  {
+    EpgEntry& epgEntry = channelEpg.GetEpgEntry(i);
+    if (epgEntry.GetGenreString().empty())
+      continue;
+
+    auto resolvedGenreString = resolvedGenreStrings.find(epgEntry.GetGenreString());
+    if (resolvedGenreString == resolvedGenreStrings.end())
+      resolvedGenreString = resolvedGenreStrings.emplace(epgEntry.GetGenreString(), FindGenreMapping(epgEntry.GetGenreString())).first;
+
+    epgEntry.SetGenreMapping(resolvedGenreString->second);
+  }
+}
+
 void Epg::MoveOldGenresXMLFileToNewLocation()
 {
   //If we don't have a genres.xml file yet copy it if it exists in any of the other old locations.
@@ -557,31 +1833,127 @@ void Epg::MoveOldGenresXMLFileToNewLocation()
   FileUtils::DeleteFile(FileUtils::GetSystemAddonPath() + "/" + GENRES_MAP_FILENAME.c_str());
 }
 
-EpgEntry* Epg::GetLiveEPGEntry(const Channel& myChannel) const
+bool Epg::GetLiveEPGEntry(const Channel& myChannel, EpgEntry& epgEntry) const
 {
-  return GetEPGEntry(myChannel, time(nullptr));
+  return GetEPGEntry(myChannel, time(nullptr), epgEntry);
 }
 
-EpgEntry* Epg::GetEPGEntry(const Channel& myChannel, time_t lookupTime) const
+bool Epg::GetEPGEntry(const Channel& myChannel, time_t lookupTime, EpgEntry& epgEntry) const
 {
-  ChannelEpg* channelEpg = FindEpgForChannel(myChannel);
-  if (!channelEpg || channelEpg->GetEpgEntries().size() == 0)
-    return nullptr;
+  const LiveEpgEntry& liveEpgEntry = GetLiveEpgEntry(myChannel);
+  ChannelEpg* channelEpg = liveEpgEntry.m_channelEpg;
+  if (!channelEpg || channelEpg->GetEpgEntryCount() == 0)
+    return false;
+
+  // What is on now is already known, other times still have to be looked up
+  if (lookupTime >= liveEpgEntry.m_validFrom && lookupTime < liveEpgEntry.m_validUntil)
+  {
+    if (liveEpgEntry.m_index == LiveEpgEntry::NO_EPG_ENTRY)
+      return false;
 
-  int shift = GetEPGTimezoneShiftSecs(myChannel);
+    epgEntry = channelEpg->CopyEpgEntry(liveEpgEntry.m_index);
+    return true;
+  }
+
+  const int shift = liveEpgEntry.m_shift;
 
-  for (auto& epgEntryPair : channelEpg->GetEpgEntries())
+  const size_t epgEntryCount = channelEpg->GetEpgEntryCount();
+  for (size_t i = channelEpg->FindFirstEpgEntryEndingAfter(lookupTime, shift); i < epgEntryCount; i++)
   {
-    auto& epgEntry = epgEntryPair.second;
-    time_t startTime = epgEntry.GetStartTime() + shift;
-    time_t endTime = epgEntry.GetEndTime() + shift;
+    time_t startTime = channelEpg->GetEpgEntryStartTime(i) + shift;
+    time_t endTime = channelEpg->GetEpgEntryEndTime(i) + shift;
     if (startTime <= lookupTime && endTime > lookupTime)
-      return &epgEntry;
+    {
+      // A copy, as the entry may be shared with other channels or have its descriptions packed
+      epgEntry = channelEpg->CopyEpgEntry(i);
+      return true;
+    }
     else if (startTime > lookupTime)
       break;
   }
 
-  return nullptr;
+  return false;
+}
+
+const Epg::LiveEpgEntry& Epg::GetLiveEpgEntry(const Channel& myChannel) const
+{
+  const time_t now = std::time(nullptr);
+
+  auto liveEpgEntry = m_liveEpgEntries.find(myChannel.GetUniqueId());
+  if (liveEpgEntry == m_liveEpgEntries.end())
+  {
+    // Deferred entries only need to be checked for the first time a channel is looked up
+    ChannelEpg* channelEpg = FindEpgForChannel(myChannel);
+    LoadDeferredEpgEntries(channelEpg);
+
+    liveEpgEntry = m_liveEpgEntries.emplace(myChannel.GetUniqueId(), LiveEpgEntry()).first;
+    liveEpgEntry->second.m_channelEpg = channelEpg;
+    liveEpgEntry->second.m_shift = GetEPGTimezoneShiftSecs(myChannel);
+  }
+  else if (now >= liveEpgEntry->second.m_validFrom && now < liveEpgEntry->second.m_validUntil)
+  {
+    return liveEpgEntry->second;
+  }
+
+  // New, or its timer has not been advanced yet
+  UpdateLiveEpgEntry(myChannel.GetUniqueId(), liveEpgEntry->second, now);
+  return liveEpgEntry->second;
+}
+
+void Epg::UpdateLiveEpgEntry(int channelUid, LiveEpgEntry& liveEpgEntry, time_t now) const
+{
+  // Only valid from now, as an earlier overlapping entry could be the one on before now
+  liveEpgEntry.m_index = LiveEpgEntry::NO_EPG_ENTRY;
+  liveEpgEntry.m_validFrom = now;
+  liveEpgEntry.m_validUntil = std::numeric_limits<time_t>::max();
+
+  ChannelEpg* channelEpg = liveEpgEntry.m_channelEpg;
+  if (!channelEpg)
+    return;
+
+  const int shift = liveEpgEntry.m_shift;
+  const size_t epgEntryCount = channelEpg->GetEpgEntryCount();
+  for (size_t i = channelEpg->FindFirstEpgEntryEndingAfter(now, shift); i < epgEntryCount; i++)
+  {
+    const time_t startTime = channelEpg->GetEpgEntryStartTime(i) + shift;
+    const time_t endTime = channelEpg->GetEpgEntryEndTime(i) + shift;
+    if (endTime <= now)
+      continue;
+
+    if (startTime <= now)
+    {
+      liveEpgEntry.m_index = i;
+      liveEpgEntry.m_validUntil = endTime;
+    }
+    else
+    {
+      // Nothing on until the next programme starts
+      liveEpgEntry.m_validUntil = startTime;
+    }
+    break;
+  }
+
+  if (liveEpgEntry.m_validUntil != std::numeric_limits<time_t>::max())
+    m_liveEpgEntryTimers.Schedule(channelUid, liveEpgEntry.m_validUntil);
+}
+
+void Epg::AdvanceLiveEpgEntries()
+{
+  const time_t now = std::time(nullptr);
+
+  m_liveEpgEntryTimers.Advance(now, [this, now](int channelUid)
+  {
+    // A timer can outlive an entry which was updated on lookup, updating it again does no harm
+    auto liveEpgEntry = m_liveEpgEntries.find(channelUid);
+    if (liveEpgEntry != m_liveEpgEntries.end() && now >= liveEpgEntry->second.m_validUntil)
+      UpdateLiveEpgEntry(channelUid, liveEpgEntry->second, now);
+  });
+}
+
+void Epg::ClearLiveEpgEntries() const
+{
+  m_liveEpgEntries.clear();
+  m_liveEpgEntryTimers.Clear();
 }
 
 int Epg::GetEPGTimezoneShiftSecs(const Channel& myChannel) const
@@ -594,11 +1966,12 @@ void Epg::MergeEpgDataIntoMedia()
   for (auto& mediaEntry : m_media.GetMediaEntryList())
   {
     ChannelEpg* channelEpg = FindEpgForMediaEntry(mediaEntry);
+    LoadDeferredEpgEntries(channelEpg);
 
     // If we have a channel EPG with entries for this media entry
     // then return the first entry as matching. This is a common pattern
     // for channel that only contain a single media item.
-    if (channelEpg && !channelEpg->GetEpgEntries().empty())
-      mediaEntry.UpdateFrom(channelEpg->GetEpgEntries().begin()->second);
+    if (channelEpg && channelEpg->GetEpgEntryCount() > 0)
+      mediaEntry.UpdateFrom(channelEpg->CopyEpgEntry(0));
   }
 }
\ No newline at end of file
@@ -7,13 +7,26 @@
 
 #pragma once
 
+#include "ChannelEpgIndex.h"
+#include "ChannelGroups.h"
+#include "EpgLoadWindow.h"
 #include "Channels.h"
 #include "Media.h"
 #include "Settings.h"
+#include "XmltvParser.h"
 #include "data/ChannelEpg.h"
 #include "data/EpgGenre.h"
+#include "utilities/StringPool.h"
+#include "utilities/TimerWheel.h"
 
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #include <kodi/addon-instance/PVR.h>
@@ -25,6 +38,7 @@ namespace iptvsimple
   static const std::string GENRE_DIR = "/genres";
   static const std::string GENRE_ADDON_DATA_BASE_DIR = ADDON_DATA_BASE_DIR + GENRE_DIR;
   static const int DEFAULT_EPG_MAX_DAYS = 3;
+  static const size_t XMLTV_MAX_QUEUED_CHUNKS = 8;
 
   enum class XmltvFileFormat
   {
@@ -33,55 +47,209 @@ namespace iptvsimple
     INVALID
   };
 
+  enum class XmltvCompression
+  {
+    NONE,
+    GZIP,
+    XZ
+  };
+
+  enum class EpgLoadState
+  {
+    NOT_LOADED,
+    LOADING,
+    READY
+  };
+
   class Epg
   {
   public:
-    Epg(kodi::addon::CInstancePVRClient* client, iptvsimple::Channels& channels, iptvsimple::Media& media);
+    Epg(kodi::addon::CInstancePVRClient* client, iptvsimple::Channels& channels, iptvsimple::ChannelGroups& channelGroups, iptvsimple::Media& media);
+    ~Epg();
 
     bool Init(int epgMaxPastDays, int epgMaxFutureDays);
 
     PVR_ERROR GetEPGForChannel(int channelUid, time_t start, time_t end, kodi::addon::PVREPGTagsResultSet& results);
     void SetEPGMaxPastDays(int epgMaxPastDays);
     void SetEPGMaxFutureDays(int epgMaxFutureDays);
+    void PruneEpgEntries();
+    void AdvanceLiveEpgEntries();
     void Clear();
     void ReloadEPG();
+    void PublishLoadedEPG();
+    void CancelLoadingEPG();
+    void WaitForCancelledLoad();
+    void StopLoadingEPG();
+    EpgLoadState GetLoadState() const { return m_loadState; }
+    void SetPlayingChannel(int channelUid);
 
-    data::EpgEntry* GetLiveEPGEntry(const data::Channel& myChannel) const;
-    data::EpgEntry* GetEPGEntry(const data::Channel& myChannel, time_t lookupTime) const;
+    bool GetLiveEPGEntry(const data::Channel& myChannel, data::EpgEntry& epgEntry) const;
+    bool GetEPGEntry(const data::Channel& myChannel, time_t lookupTime, data::EpgEntry& epgEntry) const;
     int GetEPGTimezoneShiftSecs(const data::Channel& myChannel) const;
 
   private:
-    static const XmltvFileFormat GetXMLTVFileFormat(const char* buffer);
+    typedef std::function<bool(char* chunk, size_t length)> XmltvChunkHandler;
+
+    static const XmltvFileFormat GetXMLTVFileFormat(const char* buffer, size_t length);
+    static const XmltvCompression GetXMLTVCompression(const std::string& data);
     static void MoveOldGenresXMLFileToNewLocation();
 
+    struct BackgroundLoad;
+
     bool LoadEPG(time_t iStart, time_t iEnd);
+    void LoadEPGForWindow(time_t start, time_t end);
+    bool ExtendLoadedEPG(time_t end);
+    bool LoadExtendedEpgEntries(BackgroundLoad& backgroundLoad) const;
+    void PublishExtendedEpgEntries(BackgroundLoad& backgroundLoad);
+    void DiscardExtendedEpgEntries(BackgroundLoad& backgroundLoad);
+    void LoadEPGInBackground(time_t start, time_t end);
+    void MoveLoadedEpgFrom(Epg& epg);
+    std::vector<int> GetChannelUidsByPriority() const;
+    bool LoadEpgEntriesByPriority(BackgroundLoad& backgroundLoad);
+    void PublishLoadedChannelEpgs(BackgroundLoad& backgroundLoad);
     bool GetXMLTVFileWithRetries(std::string& data);
-    char* FillBufferFromXMLTVData(std::string& data, std::string& decompressedData);
-    bool LoadChannelEpgs(const pugi::xml_node& rootElement);
-    void LoadEpgEntries(const pugi::xml_node& rootElement, int start, int end);
+    bool DecompressXMLTVData(const std::string& data, XmltvCompression compression, const XmltvChunkHandler& chunkHandler) const;
+    bool ParseXMLTV(std::string& data, time_t start, time_t end);
+    void LoadChannelEpg(const XmltvElement& element, pugi::xml_document& xmlDoc);
+    bool CheckChannelEpgsLoaded() const;
+    void GetEpgShiftRange(int& minShiftTime, int& maxShiftTime) const;
+    bool FindEpgForProgramme(const XmltvElement& element, data::ChannelEpg*& channelEpg) const;
+    bool LoadEpgEntry(const XmltvElement& element, pugi::xml_document& xmlDoc, data::ChannelEpg* channelEpg,
+                      time_t start, time_t end, int minShiftTime, int maxShiftTime) const;
+    void ShareDuplicateChannelEpgEntries();
+    void LoadDeferredEpgEntries(data::ChannelEpg* channelEpg) const;
+    int ParseDeferredEpgEntries(data::ChannelEpg& channelEpg) const;
+
+    struct LiveEpgEntry;
+    const LiveEpgEntry& GetLiveEpgEntry(const data::Channel& myChannel) const;
+    void UpdateLiveEpgEntry(int channelUid, LiveEpgEntry& liveEpgEntry, time_t now) const;
+    void ClearLiveEpgEntries() const;
+    void ClearDeferredProgrammeData() const;
+    void MoveLaterProgrammeDataFrom(Epg& epg);
+    void ClearLaterProgrammeData();
+    time_t FindFirstLaterProgrammeStart();
     bool LoadGenres();
+    const data::EpgGenre* FindGenreMapping(const std::string& genreString) const;
+    void ApplyGenreMappings(data::ChannelEpg& channelEpg, std::unordered_map<std::string, const data::EpgGenre*>& resolvedGenreStrings) const;
 
     void MergeEpgDataIntoMedia();
 
+    void IndexChannelEpgs();
+    void ClearChannelEpgIndexes();
     data::ChannelEpg* FindEpgForChannel(const std::string& id) const;
     data::ChannelEpg* FindEpgForChannel(const data::Channel& channel) const;
     data::ChannelEpg* FindEpgForMediaEntry(const data::MediaEntry& mediaEntry) const;
+    data::ChannelEpg* FindEpgForNames(const std::string& tvgId, const std::string& tvgName, const std::string& displayName) const;
     void ApplyChannelsLogosFromEPG();
 
     std::string m_xmltvLocation;
     int m_epgTimeShift;
     bool m_tsOverride;
-    int m_lastStart;
-    int m_lastEnd;
+    EpgLoadWindow m_loadWindow;
     int m_epgMaxPastDays;
     int m_epgMaxFutureDays;
     long m_epgMaxPastDaysSeconds;
     long m_epgMaxFutureDaysSeconds;
 
     iptvsimple::Channels& m_channels;
+    iptvsimple::ChannelGroups& m_channelGroups;
     iptvsimple::Media& m_media;
     std::vector<data::ChannelEpg> m_channelEpgs;
+
+    // Ids are indexed as the channels are loaded, display names once they have all been combined
+    ChannelEpgIndex m_channelEpgIndex;
+    // The channel EPG for each channel unique id, bound once per load, null if there is none
+    std::unordered_map<int, data::ChannelEpg*> m_channelEpgsByChannelUid;
     std::vector<iptvsimple::data::EpgGenre> m_genreMappings;
+    std::unordered_map<std::string, const iptvsimple::data::EpgGenre*> m_genreMappingsByName; // Keyed by lower case genre string
+
+    // Text repeated across EPG entries, kept until the next load so on demand entries can share it too
+    mutable utilities::StringPool m_stringPool;
+
+    // Programme markup for on demand loading, parsed with the window and shifts used on load
+    mutable std::string m_deferredProgrammeData;
+    mutable size_t m_deferredChannelCount = 0;
+    time_t m_deferredStart = 0;
+    time_t m_deferredEnd = 0;
+    int m_deferredMinShiftTime = 0;
+    int m_deferredMaxShiftTime = 0;
+
+    // Markup of the programmes starting after the window loaded, which ended at m_laterProgrammesFrom,
+    // up to m_laterProgrammesUntil so moving the window on only parses the programmes it moves over.
+    // 0 when nothing is kept.
+    std::string m_laterProgrammeData;
+    size_t m_laterProgrammeBytes = 0; // Of the markup not yet parsed
+    time_t m_laterProgrammesFrom = 0;
+    time_t m_laterProgrammesUntil = 0;
+    time_t m_laterProgrammesFirstStart = std::numeric_limits<time_t>::max();
+    int m_laterMinShiftTime = 0;
+    int m_laterMaxShiftTime = 0;
+
+    // The programme on now for each channel looked up, keyed by channel unique id. Each one is
+    // valid until the end of the programme, or the start of the next one if nothing is on, when
+    // its timer moves it on. Cleared whenever the channel EPGs change.
+    struct LiveEpgEntry
+    {
+      static const size_t NO_EPG_ENTRY = static_cast<size_t>(-1);
+
+      data::ChannelEpg* m_channelEpg = nullptr;
+      int m_shift = 0;
+      size_t m_index = NO_EPG_ENTRY;
+      time_t m_validFrom = 0;
+      time_t m_validUntil = 0;
+    };
+    mutable std::unordered_map<int, LiveEpgEntry> m_liveEpgEntries;
+    mutable utilities::TimerWheel m_liveEpgEntryTimers{60, 256};
+
+    // Loads run on their own thread into an Epg of their own, which is only moved into this one by
+    // PublishLoadedEPG(), so the EPG can still be used while loading. A load asked for while one is
+    // running is started once it has been published.
+    struct BackgroundLoad
+    {
+      std::unique_ptr<Epg> m_epg;
+      std::thread m_thread;
+      std::atomic<bool> m_finished{false};
+      bool m_loaded = false;
+
+      // An extension of the window has no Epg of its own, only the markup of the programmes kept
+      // after the window which it moves over, by the index of their channel EPG, to parse.
+      struct ExtendedChannelEpg
+      {
+        size_t m_channelEpgIndex;
+        std::string m_programmeData;
+        data::ChannelEpg m_channelEpg;
+      };
+      bool m_extension = false;
+      std::atomic<bool> m_extensionCancelled{false};
+      std::vector<ExtendedChannelEpg> m_extendedChannelEpgs;
+      time_t m_extendedFrom = 0;
+      time_t m_extensionStart = 0;
+      time_t m_extensionEnd = 0;
+      int m_extensionMinShiftTime = 0;
+      int m_extensionMaxShiftTime = 0;
+
+      // When loading progressively the channel EPGs are handed over without entries first, then the
+      // channel EPGs whose entries have been loaded, in order of priority, by their index.
+      bool m_progressive = false;
+      std::vector<int> m_channelUidsByPriority;
+      bool m_channelEpgsPublished = false;
+
+      // Shared with the loading thread
+      std::mutex m_mutex;
+      int m_playingChannelUid = -1;
+      bool m_channelEpgsLoaded = false;
+      std::vector<data::ChannelEpg> m_channelEpgsWithoutEntries;
+      ChannelEpgIndex m_channelEpgIndex;
+      std::vector<size_t> m_loadedChannelEpgIndexes;
+    };
+    std::unique_ptr<BackgroundLoad> m_backgroundLoad;
+    bool m_loadPending = false;
+    time_t m_pendingLoadStart = 0;
+    time_t m_pendingLoadEnd = 0;
+    EpgLoadState m_loadState = EpgLoadState::NOT_LOADED;
+    int m_playingChannelUid = -1; // The channel whose EPG is loaded first, -1 if none
+    // Set on the Epg being loaded to stop loading it as soon as possible
+    std::atomic<bool> m_loadCancelled{false};
 
     kodi::addon::CInstancePVRClient* m_client;
   };
@@ -0,0 +1,67 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "EpgLoadWindow.h"
+
+#include <algorithm>
+
+using namespace iptvsimple;
+
+namespace
+{
+
+// How far past the end of the loaded EPG a window Kodi asks for can reach before it is loaded
+// again, as the end of the window Kodi asks for moves on with the time
+const time_t EPG_WINDOW_END_SLACK_SECS = 6 * 60 * 60;
+
+} // unnamed namespace
+
+void EpgLoadWindow::Set(time_t start, time_t end)
+{
+  m_start = start;
+  m_end = end;
+}
+
+void EpgLoadWindow::Clear()
+{
+  Set(0, 0);
+}
+
+bool EpgLoadWindow::Covers(time_t start, time_t end) const
+{
+  return CoversStart(start) && end <= m_end;
+}
+
+bool EpgLoadWindow::CoversStart(time_t start) const
+{
+  return !IsEmpty() && start >= m_start;
+}
+
+bool EpgLoadWindow::CoversEndWithSlack(time_t end) const
+{
+  return !IsEmpty() && end <= m_end + EPG_WINDOW_END_SLACK_SECS;
+}
+
+void EpgLoadWindow::ExtendTo(time_t end)
+{
+  m_end = std::max(m_end, end);
+}
+
+void EpgLoadWindow::PruneTo(time_t end)
+{
+  if (!IsEmpty())
+    m_end = std::max(m_start, std::min(m_end, end));
+}
+
+void EpgLoadWindow::Widen(time_t& start, time_t& end) const
+{
+  if (IsEmpty())
+    return;
+
+  start = std::min(start, m_start);
+  end = std::max(end, m_end);
+}
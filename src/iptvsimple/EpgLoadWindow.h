@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <ctime>
+
+namespace iptvsimple
+{
+  /*
+   * The window of time the EPG has been loaded, or is being loaded, for so that only a window
+   * Kodi asks for outside of it needs a load. An empty window covers nothing.
+   */
+  class EpgLoadWindow
+  {
+  public:
+    time_t GetStart() const { return m_start; }
+    time_t GetEnd() const { return m_end; }
+    bool IsEmpty() const { return m_end <= m_start; }
+
+    void Set(time_t start, time_t end);
+    void Clear();
+
+    bool Covers(time_t start, time_t end) const;
+    // A window starting inside this one which has moved on past its end with the time
+    bool CoversStart(time_t start) const;
+    // Whether an end is close enough to this one's not to be worth loading the EPG again for
+    bool CoversEndWithSlack(time_t end) const;
+
+    void ExtendTo(time_t end);
+    // Only the end is narrowed, Kodi still asks for windows starting where its guide did and
+    // the programmes pruned before the start are ones it does not show
+    void PruneTo(time_t end);
+    // Widens a window to cover this one too
+    void Widen(time_t& start, time_t& end) const;
+
+  private:
+    time_t m_start = 0;
+    time_t m_end = 0;
+  };
+} //namespace iptvsimple
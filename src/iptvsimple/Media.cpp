@@ -140,7 +140,8 @@ const MediaEntry* Media::FindMediaEntry(const std::string& id, const std::string
   if (displayName.empty())
     return nullptr;
 
-  const std::string convertedDisplayName = std::regex_replace(displayName, std::regex(" "), "_");
+  std::string convertedDisplayName = displayName;
+  StringUtils::Replace(convertedDisplayName, ' ', '_');
   for (const auto& myMediaEntry : m_media)
   {
     if (StringUtils::EqualsNoCase(myMediaEntry.GetTvgName(), convertedDisplayName) ||
@@ -8,14 +8,15 @@
 #include "PlaylistLoader.h"
 
 #include "Settings.h"
+#include "utilities/CharsetUtils.h"
 #include "utilities/FileUtils.h"
 #include "utilities/Logger.h"
+#include "utilities/ScanUtils.h"
 #include "utilities/WebUtils.h"
 
 #include <chrono>
 #include <cstdlib>
 #include <map>
-#include <regex>
 #include <sstream>
 #include <vector>
 
@@ -59,7 +60,9 @@ bool PlaylistLoader::LoadPlayList()
     return false;
   }
 
-  std::stringstream stream(playlistContent);
+  CharsetUtils::ResetConversionCounts();
+
+  Logger::Log(LEVEL_DEBUG, "%s - Scanning %zu bytes of playlist data using %s scan kernels", __FUNCTION__, playlistContent.size(), ScanUtils::GetKernelName());
 
   /* load channels */
   bool isFirstLine = true;
@@ -74,11 +77,17 @@ bool PlaylistLoader::LoadPlayList()
   Channel tmpChannel;
   MediaEntry tmpMediaEntry;
 
+  const char* position = playlistContent.c_str();
+  const char* end = position + playlistContent.size();
+  const char* lineStart;
+  const char* lineEnd;
+
   std::string line;
-  while (std::getline(stream, line))
+  while (ScanUtils::GetNextLine(position, end, lineStart, lineEnd))
   {
-    line = StringUtils::TrimRight(line, " \t\r\n");
-    line = StringUtils::TrimLeft(line, " \t");
+    lineEnd = ScanUtils::TrimRight(lineStart, lineEnd, " \t\r\n");
+    lineStart = ScanUtils::TrimLeft(lineStart, lineEnd, " \t");
+    line.assign(lineStart, lineEnd);
 
     Logger::Log(LEVEL_DEBUG, "%s - M3U line read: '%s'", __FUNCTION__, line.c_str());
 
@@ -211,12 +220,12 @@ bool PlaylistLoader::LoadPlayList()
     }
   }
 
-  stream.clear();
-
   int milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(
                       std::chrono::high_resolution_clock::now() - started).count();
 
   Logger::Log(LEVEL_INFO, "%s Playlist Loaded - %d (ms)", __FUNCTION__, milliseconds);
+  Logger::Log(LEVEL_DEBUG, "%s - UTF-8 conversions skipped for valid UTF-8: %zu, performed: %zu", __FUNCTION__,
+              CharsetUtils::GetConversionsSkipped(), CharsetUtils::GetConversionsPerformed());
 
   if (m_channels.GetChannelsAmount() == 0 && m_media.GetNumMedia() == 0)
   {
@@ -259,7 +268,7 @@ std::string PlaylistLoader::ParseIntoChannel(const std::string& line, Channel& c
     // parse name
     std::string channelName = line.substr(commaIndex + 1);
     channelName = StringUtils::Trim(channelName);
-    kodi::UnknownToUTF8(channelName, channelName);
+    CharsetUtils::UnknownToUTF8(channelName);
     channel.SetChannelName(channelName);
 
     // parse info line containng the attributes for a channel
@@ -286,8 +295,8 @@ std::string PlaylistLoader::ParseIntoChannel(const std::string& line, Channel& c
     std::string strMediaDir = ReadMarkerValue(infoLine, MEDIA_DIR);
     std::string strMediaSize = ReadMarkerValue(infoLine, MEDIA_SIZE);
 
-    kodi::UnknownToUTF8(strTvgName, strTvgName);
-    kodi::UnknownToUTF8(strCatchupSource, strCatchupSource);
+    CharsetUtils::UnknownToUTF8(strTvgName);
+    CharsetUtils::UnknownToUTF8(strCatchupSource);
 
     // Some providers use a 'catchup-type' tag instead of 'catchup'
     if (strCatchup.empty())
@@ -467,7 +476,7 @@ void PlaylistLoader::ParseAndAddChannelGroups(const std::string& groupNamesListS
 
   while (std::getline(streamGroups, groupName, ';'))
   {
-    kodi::UnknownToUTF8(groupName, groupName);
+    CharsetUtils::UnknownToUTF8(groupName);
 
     ChannelGroup group;
     group.SetGroupName(groupName);
@@ -537,11 +546,10 @@ void PlaylistLoader::ReloadPlayList()
 
 std::string PlaylistLoader::ReadMarkerValue(const std::string& line, const std::string& markerName)
 {
-  size_t markerStart = line.find(markerName);
-  if (markerStart != std::string::npos)
+  const char* marker = ScanUtils::FindString(line.c_str(), line.c_str() + line.size(), markerName.c_str(), markerName.size());
+  if (marker)
   {
-    const std::string marker = markerName;
-    markerStart += marker.length();
+    size_t markerStart = marker - line.c_str() + markerName.length();
     if (markerStart < line.length())
     {
       char find = ' ';
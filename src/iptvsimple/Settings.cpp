@@ -102,6 +102,13 @@ void Settings::ReadFromAddon(const std::string& userPath, const std::string& cli
   m_cacheEPG = kodi::addon::GetSettingBoolean("epgCache", true);
   m_epgTimeShiftHours = kodi::addon::GetSettingFloat("epgTimeShift", 0.0f);
   m_tsOverride = kodi::addon::GetSettingBoolean("epgTSOverride", true);
+  m_epgLoadMode = kodi::addon::GetSettingEnum<EpgLoadMode>("epgLoadMode", EpgLoadMode::STREAMING);
+  m_compressEpgDescriptions = kodi::addon::GetSettingBoolean("epgCompressDescriptions", false);
+  m_loadEpgCredits = kodi::addon::GetSettingBoolean("epgLoadCredits", true);
+  m_loadEpgStarRatings = kodi::addon::GetSettingBoolean("epgLoadStarRatings", true);
+  m_loadEpgProgrammeIcons = kodi::addon::GetSettingBoolean("epgLoadProgrammeIcons", true);
+  m_epgMaxDescriptionLength = kodi::addon::GetSettingInt("epgMaxDescriptionLength", 0);
+  m_epgMaxProgrammesPerChannel = kodi::addon::GetSettingInt("epgMaxProgrammesPerChannel", 0);
 
   //Genres
   m_useEpgGenreTextWhenMapping = kodi::addon::GetSettingBoolean("useEpgGenreText", false);
@@ -245,6 +252,20 @@ ADDON_STATUS Settings::SetValue(const std::string& settingName, const kodi::addo
     return SetSetting<float, ADDON_STATUS>(settingName, settingValue, m_epgTimeShiftHours, ADDON_STATUS_OK, ADDON_STATUS_OK);
   else if (settingName == "epgTSOverride")
     return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_tsOverride, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgLoadMode")
+    return SetEnumSetting<EpgLoadMode, ADDON_STATUS>(settingName, settingValue, m_epgLoadMode, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgCompressDescriptions")
+    return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_compressEpgDescriptions, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgLoadCredits")
+    return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_loadEpgCredits, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgLoadStarRatings")
+    return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_loadEpgStarRatings, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgLoadProgrammeIcons")
+    return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_loadEpgProgrammeIcons, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgMaxDescriptionLength")
+    return SetSetting<int, ADDON_STATUS>(settingName, settingValue, m_epgMaxDescriptionLength, ADDON_STATUS_OK, ADDON_STATUS_OK);
+  else if (settingName == "epgMaxProgrammesPerChannel")
+    return SetSetting<int, ADDON_STATUS>(settingName, settingValue, m_epgMaxProgrammesPerChannel, ADDON_STATUS_OK, ADDON_STATUS_OK);
   // Genres
   else if (settingName == "useEpgGenreText")
     return SetSetting<bool, ADDON_STATUS>(settingName, settingValue, m_useEpgGenreTextWhenMapping, ADDON_STATUS_OK, ADDON_STATUS_OK);
@@ -10,6 +10,7 @@
 #include "data/Channel.h"
 #include "utilities/Logger.h"
 
+#include <algorithm>
 #include <string>
 #include <type_traits>
 
@@ -61,6 +62,15 @@ namespace iptvsimple
     PREFER_XMLTV
   };
 
+  enum class EpgLoadMode
+    : int // same type as addon settings
+  {
+    STREAMING = 0,
+    PARALLEL,
+    ON_DEMAND,
+    PROGRESSIVE
+  };
+
   enum class CatchupOverrideMode
     : int // same type as addon settings
   {
@@ -122,6 +132,13 @@ namespace iptvsimple
     float GetEpgTimeshiftHours() const { return m_epgTimeShiftHours; }
     int GetEpgTimeshiftSecs() const { return static_cast<int>(m_epgTimeShiftHours * 60 * 60); }
     bool GetTsOverride() const { return m_tsOverride; }
+    const EpgLoadMode& GetEpgLoadMode() const { return m_epgLoadMode; }
+    bool CompressEpgDescriptions() const { return m_compressEpgDescriptions; }
+    bool LoadEpgCredits() const { return m_loadEpgCredits; }
+    bool LoadEpgStarRatings() const { return m_loadEpgStarRatings; }
+    bool LoadEpgProgrammeIcons() const { return m_loadEpgProgrammeIcons; }
+    size_t GetEpgMaxDescriptionLength() const { return static_cast<size_t>(std::max(m_epgMaxDescriptionLength, 0)); }
+    size_t GetEpgMaxProgrammesPerChannel() const { return static_cast<size_t>(std::max(m_epgMaxProgrammesPerChannel, 0)); }
     bool AlwaysLoadEPGData() const { return m_epgLogosMode == EpgLogosMode::PREFER_XMLTV || IsCatchupEnabled(); }
 
     const std::string& GetGenresLocation() const { return m_genresPathType == PathType::REMOTE_PATH ? m_genresUrl : m_genresPath; }
@@ -286,6 +303,13 @@ namespace iptvsimple
     bool m_cacheEPG = false;
     float m_epgTimeShiftHours = 0;
     bool m_tsOverride = true;
+    EpgLoadMode m_epgLoadMode = EpgLoadMode::STREAMING;
+    bool m_compressEpgDescriptions = false;
+    bool m_loadEpgCredits = true;
+    bool m_loadEpgStarRatings = true;
+    bool m_loadEpgProgrammeIcons = true;
+    int m_epgMaxDescriptionLength = 0;
+    int m_epgMaxProgrammesPerChannel = 0;
 
     // Genres
     bool m_useEpgGenreTextWhenMapping = false;
@@ -0,0 +1,481 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "XmltvParser.h"
+
+#include "utilities/Logger.h"
+#include "utilities/ScanUtils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+using namespace pugi;
+
+namespace
+{
+
+// When a partial element is pending the next chunk is appended in slices of at least this size
+// so that only the bytes needed to complete the element are copied
+const size_t MIN_PENDING_SLICE_SIZE = 4096;
+
+const char PROGRAMME_ELEMENT_NAME[] = "programme";
+const char PROGRAMME_END_TAG[] = "</programme";
+const char CHANNEL_ELEMENT_NAME[] = "channel";
+const char CHANNEL_END_TAG[] = "</channel";
+const char ROOT_ELEMENT_NAME[] = "tv";
+
+// The parse_default options except for parse_wconv_attribute as the attributes we use never
+// contain whitespace characters other than space
+const unsigned int XMLTV_PARSE_OPTIONS = parse_cdata | parse_escapes | parse_eol;
+
+bool IsWhitespace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool IsNameEnd(char c)
+{
+  return IsWhitespace(c) || c == '/' || c == '>';
+}
+
+bool NameEquals(const char* name, const char* nameEnd, const char* value, size_t valueLength)
+{
+  return static_cast<size_t>(nameEnd - name) == valueLength && std::memcmp(name, value, valueLength) == 0;
+}
+
+const char* FindString(const char* position, const char* end, const char* needle, size_t needleLength)
+{
+  return ScanUtils::FindString(position, end, needle, needleLength);
+}
+
+const char* FindEndTag(const char* position, const char* end, const char* endTag, size_t endTagLength)
+{
+  // Descriptions can be wrapped in CDATA sections which may contain anything but their own terminator
+  while (true)
+  {
+    const char* endTagStart = FindString(position, end, endTag, endTagLength);
+    if (!endTagStart)
+      return nullptr;
+
+    const char* cdataStart = FindString(position, endTagStart, "<![CDATA[", 9);
+    if (!cdataStart)
+      return endTagStart;
+
+    const char* cdataEnd = FindString(cdataStart + 9, end, "]]>", 3);
+    if (!cdataEnd)
+      return nullptr;
+
+    position = cdataEnd + 3;
+  }
+}
+
+const char* FindDeclarationEnd(const char* position, const char* end)
+{
+  // e.g. <!DOCTYPE tv SYSTEM "xmltv.dtd"> which may also have an internal subset in brackets
+  char quote = 0;
+  int depth = 0;
+  for (; position < end; position++)
+  {
+    if (quote)
+    {
+      if (*position == quote)
+        quote = 0;
+    }
+    else if (*position == '"' || *position == '\'')
+      quote = *position;
+    else if (*position == '[')
+      depth++;
+    else if (*position == ']')
+      depth--;
+    else if (*position == '>' && depth <= 0)
+      return position;
+  }
+
+  return nullptr;
+}
+
+void AppendUtf8(unsigned long codePoint, std::string& value)
+{
+  if (codePoint < 0x80)
+  {
+    value += static_cast<char>(codePoint);
+  }
+  else if (codePoint < 0x800)
+  {
+    value += static_cast<char>(0xC0 | (codePoint >> 6));
+    value += static_cast<char>(0x80 | (codePoint & 0x3F));
+  }
+  else if (codePoint < 0x10000)
+  {
+    value += static_cast<char>(0xE0 | (codePoint >> 12));
+    value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    value += static_cast<char>(0x80 | (codePoint & 0x3F));
+  }
+  else
+  {
+    value += static_cast<char>(0xF0 | (codePoint >> 18));
+    value += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+    value += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+    value += static_cast<char>(0x80 | (codePoint & 0x3F));
+  }
+}
+
+} // unnamed namespace
+
+XmltvParser::XmltvParser(const ElementHandler& elementHandler, bool requireRootElement /* true */)
+  : m_elementHandler(elementHandler), m_foundRootElement(!requireRootElement)
+{
+}
+
+bool XmltvParser::Parse(char* data, size_t length)
+{
+  if (m_aborted)
+    return false;
+
+  size_t used = 0;
+
+  // First complete any element left over from the previous chunk. Once the leftover is
+  // consumed we continue to scan the new data where it is instead of copying it.
+  while (!m_pending.empty() && used < length)
+  {
+    size_t sliceLength = std::min(length - used, std::max(m_pending.size(), MIN_PENDING_SLICE_SIZE));
+    m_pending.append(data + used, sliceLength);
+    used += sliceLength;
+
+    size_t consumed = ScanBuffer(&m_pending[0], m_pending.size());
+    if (m_aborted)
+      return false;
+
+    m_streamOffset += consumed;
+    m_pending.erase(0, consumed);
+
+    if (m_pending.size() <= sliceLength)
+    {
+      used -= m_pending.size();
+      m_pending.clear();
+    }
+
+    m_maxPendingLength = std::max(m_maxPendingLength, m_pending.size());
+  }
+
+  if (used < length)
+  {
+    size_t consumed = ScanBuffer(data + used, length - used);
+    if (m_aborted)
+      return false;
+
+    m_streamOffset += consumed;
+    m_pending.assign(data + used + consumed, length - used - consumed);
+    m_maxPendingLength = std::max(m_maxPendingLength, m_pending.size());
+  }
+
+  return true;
+}
+
+bool XmltvParser::Finish()
+{
+  if (!m_pending.empty())
+  {
+    if (std::memchr(m_pending.data(), '<', m_pending.size()))
+      Logger::Log(LEVEL_WARNING, "%s - XMLTV data ends with an incomplete element at offset: %zu", __FUNCTION__, m_streamOffset);
+
+    m_streamOffset += m_pending.size();
+    m_pending.clear();
+    m_pending.shrink_to_fit();
+  }
+
+  return !m_aborted;
+}
+
+size_t XmltvParser::ScanBuffer(char* buffer, size_t length)
+{
+  const char* position = buffer;
+  const char* end = buffer + length;
+
+  while (position < end)
+  {
+    const char* tagStart = static_cast<const char*>(std::memchr(position, '<', end - position));
+    if (!tagStart)
+      return length; // Character data between the elements is not of interest
+
+    position = tagStart;
+    if (end - tagStart < 2)
+      break;
+
+    const char* tagEnd = nullptr;
+
+    if (tagStart[1] == '!')
+    {
+      if (end - tagStart < 9)
+        break;
+
+      if (std::memcmp(tagStart, "<!--", 4) == 0)
+      {
+        tagEnd = FindString(tagStart + 4, end, "-->", 3);
+        if (tagEnd)
+          tagEnd += 2;
+      }
+      else if (std::memcmp(tagStart, "<![CDATA[", 9) == 0)
+      {
+        tagEnd = FindString(tagStart + 9, end, "]]>", 3);
+        if (tagEnd)
+          tagEnd += 2;
+      }
+      else
+      {
+        tagEnd = FindDeclarationEnd(tagStart + 2, end);
+      }
+    }
+    else if (tagStart[1] == '?')
+    {
+      tagEnd = FindString(tagStart + 2, end, "?>", 2);
+      if (tagEnd)
+        tagEnd += 1;
+    }
+    else if (tagStart[1] == '/')
+    {
+      tagEnd = static_cast<const char*>(std::memchr(tagStart + 2, '>', end - tagStart - 2));
+    }
+    else
+    {
+      const char* nameEnd = tagStart + 1;
+      while (nameEnd < end && !IsNameEnd(*nameEnd))
+        nameEnd++;
+
+      if (nameEnd == end)
+        break;
+
+      tagEnd = FindStartTagEnd(nameEnd, end);
+      if (!tagEnd)
+        break;
+
+      XmltvElementType type;
+      const char* endTag;
+      size_t endTagLength;
+
+      if (NameEquals(tagStart + 1, nameEnd, PROGRAMME_ELEMENT_NAME, sizeof(PROGRAMME_ELEMENT_NAME) - 1))
+      {
+        type = XmltvElementType::PROGRAMME;
+        endTag = PROGRAMME_END_TAG;
+        endTagLength = sizeof(PROGRAMME_END_TAG) - 1;
+      }
+      else if (NameEquals(tagStart + 1, nameEnd, CHANNEL_ELEMENT_NAME, sizeof(CHANNEL_ELEMENT_NAME) - 1))
+      {
+        type = XmltvElementType::CHANNEL;
+        endTag = CHANNEL_END_TAG;
+        endTagLength = sizeof(CHANNEL_END_TAG) - 1;
+      }
+      else
+      {
+        // Any other start tag is skipped, the only one we care about is the root element
+        if (NameEquals(tagStart + 1, nameEnd, ROOT_ELEMENT_NAME, sizeof(ROOT_ELEMENT_NAME) - 1))
+          m_foundRootElement = true;
+
+        position = tagEnd + 1;
+        continue;
+      }
+
+      // Elements outside of the <tv> root are not part of the EPG
+      if (!m_foundRootElement)
+      {
+        position = tagEnd + 1;
+        continue;
+      }
+
+      const char* elementEnd = tagEnd;
+      if (tagEnd[-1] != '/')
+      {
+        const char* endTagStart = FindEndTag(tagEnd + 1, end, endTag, endTagLength);
+        if (!endTagStart)
+          break;
+
+        elementEnd = static_cast<const char*>(std::memchr(endTagStart + endTagLength, '>', end - endTagStart - endTagLength));
+        if (!elementEnd)
+          break;
+      }
+
+      if (!EmitElement(type, buffer + (tagStart - buffer), elementEnd + 1 - tagStart, tagEnd, m_streamOffset + (tagStart - buffer)))
+      {
+        m_aborted = true;
+        return 0;
+      }
+
+      position = elementEnd + 1;
+      continue;
+    }
+
+    if (!tagEnd)
+      break;
+
+    position = tagEnd + 1;
+  }
+
+  return position - buffer;
+}
+
+bool XmltvParser::EmitElement(XmltvElementType type, char* data, size_t length, const char* startTagEnd, size_t offset)
+{
+  XmltvElement element;
+  element.m_type = type;
+  element.m_data = data;
+  element.m_length = length;
+  element.m_offset = offset;
+
+  if (type == XmltvElementType::PROGRAMME)
+  {
+    m_programmeElementCount++;
+    GetStartTagAttribute(data, startTagEnd, "channel", element.m_id);
+  }
+  else
+  {
+    m_channelElementCount++;
+    GetStartTagAttribute(data, startTagEnd, "id", element.m_id);
+  }
+
+  return m_elementHandler(element);
+}
+
+const char* XmltvParser::FindStartTagEnd(const char* position, const char* end)
+{
+  // Attribute values may legally contain '>' so quotes need to be respected
+  while (position < end)
+  {
+    position = ScanUtils::FindAnyOf(position, end, '>', '"', '\'');
+    if (!position || *position == '>')
+      return position;
+
+    position = ScanUtils::FindChar(position + 1, end, *position);
+    if (!position)
+      return nullptr;
+
+    position++;
+  }
+
+  return nullptr;
+}
+
+bool XmltvParser::GetStartTagAttribute(const char* startTag, const char* startTagEnd, const char* name, std::string& value)
+{
+  const size_t nameLength = std::strlen(name);
+
+  // Skip the element name
+  const char* position = startTag + 1;
+  while (position < startTagEnd && !IsNameEnd(*position))
+    position++;
+
+  while (position < startTagEnd)
+  {
+    while (position < startTagEnd && (IsWhitespace(*position) || *position == '/'))
+      position++;
+
+    const char* attributeName = position;
+    while (position < startTagEnd && *position != '=' && !IsWhitespace(*position))
+      position++;
+    const char* attributeNameEnd = position;
+
+    while (position < startTagEnd && IsWhitespace(*position))
+      position++;
+    if (position == startTagEnd || *position != '=')
+      return false;
+    position++;
+    while (position < startTagEnd && IsWhitespace(*position))
+      position++;
+    if (position == startTagEnd || (*position != '"' && *position != '\''))
+      return false;
+
+    const char quote = *position++;
+    const char* valueEnd = static_cast<const char*>(std::memchr(position, quote, startTagEnd - position));
+    if (!valueEnd)
+      return false;
+
+    if (NameEquals(attributeName, attributeNameEnd, name, nameLength))
+    {
+      DecodeXmlEntities(position, valueEnd - position, value);
+      return true;
+    }
+
+    position = valueEnd + 1;
+  }
+
+  return false;
+}
+
+void XmltvParser::DecodeXmlEntities(const char* data, size_t length, std::string& value)
+{
+  value.clear();
+  value.reserve(length);
+
+  const char* end = data + length;
+  while (data < end)
+  {
+    const char* ampersand = static_cast<const char*>(std::memchr(data, '&', end - data));
+    if (!ampersand)
+    {
+      value.append(data, end - data);
+      break;
+    }
+
+    value.append(data, ampersand - data);
+    data = ampersand;
+
+    const char* semicolon = static_cast<const char*>(std::memchr(ampersand, ';', std::min<size_t>(end - ampersand, 12)));
+    if (semicolon)
+    {
+      const char* entity = ampersand + 1;
+      const size_t entityLength = semicolon - entity;
+
+      if (NameEquals(entity, semicolon, "amp", 3))
+        value += '&';
+      else if (NameEquals(entity, semicolon, "lt", 2))
+        value += '<';
+      else if (NameEquals(entity, semicolon, "gt", 2))
+        value += '>';
+      else if (NameEquals(entity, semicolon, "quot", 4))
+        value += '"';
+      else if (NameEquals(entity, semicolon, "apos", 4))
+        value += '\'';
+      else if (entityLength > 1 && entity[0] == '#')
+        AppendUtf8(entity[1] == 'x' ? std::strtoul(entity + 2, nullptr, 16) : std::strtoul(entity + 1, nullptr, 10), value);
+      else
+        semicolon = nullptr;
+    }
+
+    if (semicolon)
+    {
+      data = semicolon + 1;
+    }
+    else
+    {
+      value += '&';
+      data++;
+    }
+  }
+}
+
+bool XmltvParser::LoadElement(const XmltvElement& element, xml_document& xmlDoc)
+{
+  // Parsing in place saves pugixml taking a copy, the markup is not needed afterwards
+  xml_parse_result result = xmlDoc.load_buffer_inplace(element.m_data, element.m_length, XMLTV_PARSE_OPTIONS, encoding_utf8);
+
+  if (!result)
+  {
+    Logger::Log(LEVEL_ERROR, "%s - Unable parse EPG XML element: %s, offset: %zu", __FUNCTION__, result.description(), element.m_offset + result.offset);
+    return false;
+  }
+
+  return true;
+}
+
+bool XmltvParser::GetElementAttribute(const XmltvElement& element, const char* name, std::string& value)
+{
+  const char* startTagEnd = FindStartTagEnd(element.m_data, element.m_data + element.m_length);
+
+  return startTagEnd && GetStartTagAttribute(element.m_data, startTagEnd, name, value);
+}
@@ -0,0 +1,86 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include <pugixml.hpp>
+
+namespace iptvsimple
+{
+  enum class XmltvElementType
+  {
+    CHANNEL,
+    PROGRAMME
+  };
+
+  struct XmltvElement
+  {
+    XmltvElementType m_type;
+    char* m_data;        // Start of the element markup, i.e. the '<' of the start tag
+    size_t m_length;     // Length of the markup up to and including the end tag
+    size_t m_offset;     // Offset of the element in the XMLTV stream
+    std::string m_id;    // The 'id' attribute of a channel or the 'channel' attribute of a programme
+  };
+
+  /*
+   * Incremental scanner for XMLTV data. Instead of building a DOM for the whole file it is
+   * fed the data in chunks of any size and hands each top level <channel> and <programme>
+   * element to the handler as soon as it is complete. Only the bytes of a partially received
+   * element are ever held by the parser, so the working set is bound by the largest element
+   * rather than the size of the file.
+   *
+   * The handler can inspect the element id cheaply and only call LoadElement() for the
+   * elements it is actually interested in. Returning false from the handler stops the parse.
+   *
+   * Elements are only handled inside the <tv> root element unless requireRootElement is
+   * false, which allows data previously cut out of an XMLTV file to be parsed again.
+   *
+   * To avoid copying, LoadElement() parses the markup in place which modifies it. The data
+   * passed to Parse() must therefore be writable and not be used again once parsed.
+   */
+  class XmltvParser
+  {
+  public:
+    typedef std::function<bool(const XmltvElement& element)> ElementHandler;
+
+    XmltvParser(const ElementHandler& elementHandler, bool requireRootElement = true);
+
+    bool Parse(char* data, size_t length);
+    bool Finish();
+
+    bool FoundRootElement() const { return m_foundRootElement; }
+    bool IsAborted() const { return m_aborted; }
+    size_t GetBytesParsed() const { return m_streamOffset; }
+    size_t GetChannelElementCount() const { return m_channelElementCount; }
+    size_t GetProgrammeElementCount() const { return m_programmeElementCount; }
+    size_t GetMaxPendingLength() const { return m_maxPendingLength; }
+
+    static bool LoadElement(const XmltvElement& element, pugi::xml_document& xmlDoc);
+    // Read an attribute of the element's start tag without loading the element
+    static bool GetElementAttribute(const XmltvElement& element, const char* name, std::string& value);
+
+  private:
+    size_t ScanBuffer(char* buffer, size_t length);
+    bool EmitElement(XmltvElementType type, char* data, size_t length, const char* startTagEnd, size_t offset);
+
+    static const char* FindStartTagEnd(const char* position, const char* end);
+    static bool GetStartTagAttribute(const char* startTag, const char* startTagEnd, const char* name, std::string& value);
+    static void DecodeXmlEntities(const char* data, size_t length, std::string& value);
+
+    ElementHandler m_elementHandler;
+    std::string m_pending;
+    size_t m_streamOffset = 0; // Stream offset of the first byte not yet consumed
+    size_t m_maxPendingLength = 0;
+    size_t m_channelElementCount = 0;
+    size_t m_programmeElementCount = 0;
+    bool m_foundRootElement = false;
+    bool m_aborted = false;
+  };
+} //namespace iptvsimple
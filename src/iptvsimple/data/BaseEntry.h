@@ -8,6 +8,7 @@
 
 #pragma once
 
+#include "../utilities/StringPool.h"
 #include "EpgGenre.h"
 
 #include <string>
@@ -90,6 +91,22 @@ namespace iptvsimple
       void SetPremiere(int value) { m_premiere = value; }
 
     protected:
+      // Shares the text of another entry instead of copying it, an entry without an icon keeps the current one
+      void ShareTextFrom(const BaseEntry& entry)
+      {
+        m_title = entry.m_title;
+        m_episodeName = entry.m_episodeName;
+        if (!entry.m_iconPath.empty())
+          m_iconPath = entry.m_iconPath;
+        m_genreString = entry.m_genreString;
+        m_cast = entry.m_cast;
+        m_director = entry.m_director;
+        m_writer = entry.m_writer;
+        m_parentalRating = entry.m_parentalRating;
+        m_parentalRatingSystem = entry.m_parentalRatingSystem;
+        m_parentalRatingIconPath = entry.m_parentalRatingIconPath;
+      }
+
       int m_genreType = 0;
       int m_genreSubType = 0;
       int m_year = 0;
@@ -98,20 +115,20 @@ namespace iptvsimple
       int m_seasonNumber = EPG_TAG_INVALID_SERIES_EPISODE;
 
       std::string m_firstAired;
-      std::string m_title;
-      std::string m_episodeName;
+      utilities::InternedString m_title;
+      utilities::InternedString m_episodeName;
       std::string m_plotOutline;
       std::string m_plot;
-      std::string m_iconPath;
-      std::string m_genreString;
+      utilities::InternedString m_iconPath;
+      utilities::InternedString m_genreString;
 
-      std::string m_cast;
-      std::string m_director;
-      std::string m_writer;
+      utilities::InternedString m_cast;
+      utilities::InternedString m_director;
+      utilities::InternedString m_writer;
 
-      std::string m_parentalRating;
-      std::string m_parentalRatingSystem;
-      std::string m_parentalRatingIconPath;
+      utilities::InternedString m_parentalRating;
+      utilities::InternedString m_parentalRatingSystem;
+      utilities::InternedString m_parentalRatingIconPath;
       int m_starRating;
 
       bool m_new = false;
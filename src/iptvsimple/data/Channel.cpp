@@ -8,6 +8,7 @@
 #include "Channel.h"
 
 #include "../Settings.h"
+#include "../utilities/CharsetUtils.h"
 #include "../utilities/FileUtils.h"
 #include "../utilities/Logger.h"
 #include "../utilities/StreamUtils.h"
@@ -127,7 +128,7 @@ void Channel::SetIconPathFromTvgLogo(const std::string& tvgLogo, std::string& ch
     logoSetFromChannelName = true;
   }
 
-  kodi::UnknownToUTF8(m_iconPath, m_iconPath);
+  CharsetUtils::UnknownToUTF8(m_iconPath);
 
   // urlencode channel logo when set from channel name and source is Remote Path
   // append extension as channel name wouldn't have it
@@ -236,14 +237,28 @@ bool Channel::SupportsLiveStreamTimeshifting() const
 
 namespace
 {
-bool IsValidTimeshiftingCatchupSource(const std::string& formatString, const CatchupMode& catchupMode)
+int CountSpecifiers(const std::string& formatString)
 {
-  // match any specifier, i.e. anything inside curly braces
-  std::regex const specifierRegex("\\{[^{]+\\}");
+  // Count any specifier, i.e. anything inside curly braces. The same as counting the matches
+  // of "\{[^{]+\}" so a specifier runs from a '{' to the last '}' before the next '{'
+  int numSpecifiers = 0;
+  size_t specifierStart = formatString.find('{');
+  while (specifierStart != std::string::npos)
+  {
+    const size_t nextSpecifierStart = formatString.find('{', specifierStart + 1);
+    const size_t specifierEnd = formatString.rfind('}', nextSpecifierStart == std::string::npos ? std::string::npos : nextSpecifierStart - 1);
+    if (specifierEnd != std::string::npos && specifierEnd > specifierStart + 1)
+      numSpecifiers++;
+
+    specifierStart = nextSpecifierStart;
+  }
 
-  std::ptrdiff_t const numSpecifiers(std::distance(
-    std::sregex_iterator(formatString.begin(), formatString.end(), specifierRegex),
-    std::sregex_iterator()));
+  return numSpecifiers;
+}
+
+bool IsValidTimeshiftingCatchupSource(const std::string& formatString, const CatchupMode& catchupMode)
+{
+  const int numSpecifiers = CountSpecifiers(formatString);
 
   if (numSpecifiers > 0)
   {
@@ -7,13 +7,23 @@
 
 #include "ChannelEpg.h"
 
+#include "../utilities/Logger.h"
 #include "../utilities/XMLUtils.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <limits>
+#include <mutex>
+#include <unordered_map>
+
 #include <kodi/tools/StringUtils.h>
+#include <zlib.h>
 
 using namespace kodi::tools;
 using namespace iptvsimple;
 using namespace iptvsimple::data;
+using namespace iptvsimple::utilities;
 using namespace pugi;
 
 bool ChannelEpg::UpdateFrom(const xml_node& channelNode, Channels& channels, Media& media)
@@ -72,6 +82,680 @@ bool ChannelEpg::CombineNamesAndIconPathFrom(const ChannelEpg& right)
   return combined;
 }
 
+namespace
+{
+
+int32_t ToRelativeTime(time_t time, time_t baseTime)
+{
+  const time_t relativeTime = time - baseTime;
+  if (relativeTime <= std::numeric_limits<int32_t>::min())
+    return std::numeric_limits<int32_t>::min();
+  if (relativeTime >= std::numeric_limits<int32_t>::max())
+    return std::numeric_limits<int32_t>::max();
+
+  return static_cast<int32_t>(relativeTime);
+}
+
+bool IsSaturated(int32_t relativeTime)
+{
+  return relativeTime == std::numeric_limits<int32_t>::min() || relativeTime == std::numeric_limits<int32_t>::max();
+}
+
+// Descriptions are packed into blocks of around this much text. Neighbouring programmes often
+// repeat each other so this is big enough to compress well and still quick to decompress.
+const size_t DESCRIPTION_BLOCK_SIZE = 32 * 1024;
+
+std::atomic<uint64_t> nextDescriptionBlockId{1};
+
+// Kodi asks for the tags of a channel in time order, so a few recently decoded blocks shared
+// by all channels is enough to only decompress each block about once per request
+const size_t DECODED_BLOCK_CACHE_SIZE = 8;
+
+struct DecodedBlock
+{
+  uint64_t m_id = 0;
+  uint64_t m_lastUsed = 0;
+  std::string m_text;
+};
+
+std::mutex decodedBlocksMutex;
+DecodedBlock decodedBlocks[DECODED_BLOCK_CACHE_SIZE];
+uint64_t decodedBlockUseCount = 0;
+
+} // unnamed namespace
+
+time_t ChannelEpg::GetEpgEntryStartTime(size_t index) const
+{
+  const size_t storeIndex = ToStoreIndex(index);
+  const int32_t relativeTime = m_epgEntryStore->m_epgEntryStartTimes[storeIndex];
+  if (IsSaturated(relativeTime))
+    return m_epgEntryStore->m_epgEntries[storeIndex].GetStartTime() + m_epgEntryOffset;
+
+  return m_epgEntryStore->m_epgEntryBaseTime + relativeTime + m_epgEntryOffset;
+}
+
+time_t ChannelEpg::GetEpgEntryEndTime(size_t index) const
+{
+  const size_t storeIndex = ToStoreIndex(index);
+  const int32_t relativeTime = m_epgEntryStore->m_epgEntryEndTimes[storeIndex];
+  if (IsSaturated(relativeTime))
+    return m_epgEntryStore->m_epgEntries[storeIndex].GetEndTime() + m_epgEntryOffset;
+
+  return m_epgEntryStore->m_epgEntryBaseTime + relativeTime + m_epgEntryOffset;
+}
+
+EpgEntry ChannelEpg::CopyEpgEntry(size_t index) const
+{
+  EpgEntry epgEntry = m_epgEntryStore->m_epgEntries[ToStoreIndex(index)];
+
+  if (m_epgEntryOffset != 0)
+  {
+    epgEntry.SetStartTime(epgEntry.GetStartTime() + m_epgEntryOffset);
+    epgEntry.SetEndTime(epgEntry.GetEndTime() + m_epgEntryOffset);
+    epgEntry.SetBroadcastId(epgEntry.GetBroadcastId() + static_cast<int>(m_epgEntryOffset));
+  }
+
+  // A shared entry may have come from another channel
+  epgEntry.SetChannelId(std::atoi(m_id.c_str()));
+
+  std::string plot;
+  std::string plotOutline;
+  if (GetEpgEntryDescriptions(index, plot, plotOutline))
+    epgEntry.UnpackDescriptions(plot, plotOutline);
+
+  return epgEntry;
+}
+
+void ChannelEpg::UpdateEpgEntryTo(size_t index, kodi::addon::PVREPGTag& tag, int channelUid, int timeShift) const
+{
+  const EpgEntry& epgEntry = m_epgEntryStore->m_epgEntries[ToStoreIndex(index)];
+
+  epgEntry.UpdateTo(tag, channelUid, timeShift + static_cast<int>(m_epgEntryOffset));
+  if (m_epgEntryOffset != 0)
+    tag.SetUniqueBroadcastId(epgEntry.GetBroadcastId() + static_cast<int>(m_epgEntryOffset));
+
+  // Reused so sending the tags of a channel doesn't allocate for each one
+  thread_local std::string plot;
+  thread_local std::string plotOutline;
+  if (GetEpgEntryDescriptions(index, plot, plotOutline))
+  {
+    tag.SetPlot(plot);
+    tag.SetPlotOutline(plotOutline);
+  }
+}
+
+void ChannelEpg::AddEpgEntry(const EpgEntry& epgEntry)
+{
+  MakeEpgEntryStoreUnique();
+  EpgEntryStore& store = *m_epgEntryStore;
+
+  // Programmes almost always arrive in order so sorting can usually be skipped entirely
+  if (!store.m_epgEntries.empty() && epgEntry.GetStartTime() <= store.m_epgEntries.back().GetStartTime())
+    store.m_epgEntriesSorted = false;
+
+  store.m_epgEntries.emplace_back(epgEntry);
+  store.m_epgEntryTimesBuilt = false;
+  store.m_maxEpgEntryDuration = std::max(store.m_maxEpgEntryDuration, epgEntry.GetEndTime() - epgEntry.GetStartTime());
+  m_epgEntryCount = store.m_epgEntries.size();
+}
+
+void ChannelEpg::AddLaterEpgEntriesFrom(ChannelEpg& channelEpg)
+{
+  SortEpgEntries();
+  channelEpg.SortEpgEntries();
+  if (channelEpg.m_epgEntryCount == 0)
+    return;
+
+  const std::vector<EpgEntry>& laterEpgEntries = channelEpg.m_epgEntryStore->m_epgEntries;
+  size_t added = 0;
+
+  // Entries which follow on from ours go into the store we use, shared or not, with its times. Where
+  // another channel EPG using it has added them already only our range is extended.
+  if (m_epgEntryCount > 0 && laterEpgEntries.front().GetStartTime() > GetEpgEntryStartTime(m_epgEntryCount - 1))
+  {
+    EpgEntryStore& store = *m_epgEntryStore;
+    for (; added < laterEpgEntries.size(); added++)
+    {
+      EpgEntry epgEntry = laterEpgEntries[added];
+      epgEntry.SetStartTime(epgEntry.GetStartTime() - m_epgEntryOffset);
+      epgEntry.SetEndTime(epgEntry.GetEndTime() - m_epgEntryOffset);
+      epgEntry.SetBroadcastId(epgEntry.GetBroadcastId() - static_cast<int>(m_epgEntryOffset));
+
+      const size_t storeIndex = ToStoreIndex(m_epgEntryCount);
+      if (storeIndex < store.m_epgEntries.size())
+      {
+        EpgEntry storeEntry = store.m_epgEntries[storeIndex];
+        std::string plot;
+        std::string plotOutline;
+        if (GetEpgEntryDescriptions(m_epgEntryCount, plot, plotOutline))
+          storeEntry.UnpackDescriptions(plot, plotOutline);
+
+        if (storeEntry.GetStartTime() != epgEntry.GetStartTime() || storeEntry.GetEndTime() != epgEntry.GetEndTime() ||
+            !storeEntry.IsSameProgrammeAs(epgEntry))
+          break;
+      }
+      else
+      {
+        store.m_maxEpgEntryDuration = std::max(store.m_maxEpgEntryDuration, epgEntry.GetEndTime() - epgEntry.GetStartTime());
+        store.m_epgEntries.emplace_back(std::move(epgEntry));
+        store.m_epgEntryTimesBuilt = false;
+      }
+
+      m_epgEntryCount++;
+    }
+  }
+
+  // The rest can only be added to a store of our own
+  for (; added < laterEpgEntries.size(); added++)
+    AddEpgEntry(laterEpgEntries[added]);
+
+  SortEpgEntries();
+}
+
+void ChannelEpg::MakeEpgEntryStoreUnique()
+{
+  if (!m_epgEntryStore)
+  {
+    m_epgEntryStore = std::make_shared<EpgEntryStore>();
+    return;
+  }
+
+  if (m_epgEntryStore.use_count() == 1 && m_epgEntryOffset == 0 && ToStoreIndex(0) == 0 &&
+      m_epgEntryCount == m_epgEntryStore->m_epgEntries.size())
+    return;
+
+  // Take a copy of just our own entries with our own times
+  std::shared_ptr<EpgEntryStore> store = std::make_shared<EpgEntryStore>();
+  store->m_epgEntries.reserve(m_epgEntryCount);
+  for (size_t i = 0; i < m_epgEntryCount; i++)
+  {
+    EpgEntry epgEntry = m_epgEntryStore->m_epgEntries[ToStoreIndex(i)];
+    if (m_epgEntryOffset != 0)
+    {
+      epgEntry.SetStartTime(epgEntry.GetStartTime() + m_epgEntryOffset);
+      epgEntry.SetEndTime(epgEntry.GetEndTime() + m_epgEntryOffset);
+      epgEntry.SetBroadcastId(epgEntry.GetBroadcastId() + static_cast<int>(m_epgEntryOffset));
+    }
+
+    store->m_maxEpgEntryDuration = std::max(store->m_maxEpgEntryDuration, epgEntry.GetEndTime() - epgEntry.GetStartTime());
+    store->m_epgEntries.emplace_back(std::move(epgEntry));
+  }
+  store->m_epgEntryTimesBuilt = false;
+
+  // Entries are packed in order so the blocks our entries use are a single range, only those are
+  // copied rather than the blocks of every channel EPG sharing the store
+  uint32_t firstBlock = PackedDescriptions::NO_BLOCK;
+  uint32_t lastBlock = 0;
+  for (const auto& epgEntry : store->m_epgEntries)
+  {
+    if (epgEntry.HasPackedDescriptions())
+    {
+      firstBlock = std::min(firstBlock, epgEntry.GetPackedDescriptions().m_block);
+      lastBlock = std::max(lastBlock, epgEntry.GetPackedDescriptions().m_block);
+    }
+  }
+
+  if (firstBlock != PackedDescriptions::NO_BLOCK)
+  {
+    const std::vector<DescriptionBlock>& descriptionBlocks = m_epgEntryStore->m_descriptionBlocks;
+    store->m_descriptionBlocks.assign(descriptionBlocks.begin() + firstBlock, descriptionBlocks.begin() + lastBlock + 1);
+    for (const auto& block : store->m_descriptionBlocks)
+    {
+      store->m_descriptionBytes += block.m_size;
+      store->m_compressedDescriptionBytes += block.m_data.size();
+    }
+
+    if (firstBlock > 0)
+    {
+      for (auto& epgEntry : store->m_epgEntries)
+      {
+        if (epgEntry.HasPackedDescriptions())
+          epgEntry.MovePackedDescriptions(epgEntry.GetPackedDescriptions().m_block - firstBlock);
+      }
+    }
+  }
+
+  m_epgEntryStore = store;
+  m_firstEpgEntry = 0;
+  m_epgEntryOffset = 0;
+  m_sharesEpgEntries = false;
+}
+
+void ChannelEpg::SortEpgEntries()
+{
+  if (!m_epgEntryStore)
+    return;
+
+  // Entries are only ever added to a store of our own, so that is the only time it needs sorting
+  EpgEntryStore& store = *m_epgEntryStore;
+  if (!store.m_epgEntriesSorted)
+  {
+    std::stable_sort(store.m_epgEntries.begin(), store.m_epgEntries.end(), [](const EpgEntry& left, const EpgEntry& right)
+    {
+      return left.GetStartTime() < right.GetStartTime();
+    });
+
+    // Where entries share a start time the last one added replaces the others
+    auto uniqueEnd = store.m_epgEntries.begin();
+    for (auto it = store.m_epgEntries.begin(); it != store.m_epgEntries.end(); ++it)
+    {
+      auto next = it + 1;
+      if (next != store.m_epgEntries.end() && next->GetStartTime() == it->GetStartTime())
+        continue;
+
+      if (uniqueEnd != it)
+        *uniqueEnd = std::move(*it);
+      ++uniqueEnd;
+    }
+    store.m_epgEntries.erase(uniqueEnd, store.m_epgEntries.end());
+    m_epgEntryCount = store.m_epgEntries.size();
+
+    store.m_epgEntriesSorted = true;
+  }
+
+  if (!store.m_epgEntryTimesBuilt)
+    BuildEpgEntryTimes();
+}
+
+void ChannelEpg::BuildEpgEntryTimes()
+{
+  EpgEntryStore& store = *m_epgEntryStore;
+
+  store.m_epgEntryBaseTime = store.m_epgEntries.empty() ? 0 : store.m_epgEntries.front().GetStartTime();
+  store.m_epgEntryStartTimes.resize(store.m_epgEntries.size());
+  store.m_epgEntryEndTimes.resize(store.m_epgEntries.size());
+  for (size_t i = 0; i < store.m_epgEntries.size(); i++)
+  {
+    store.m_epgEntryStartTimes[i] = ToRelativeTime(store.m_epgEntries[i].GetStartTime(), store.m_epgEntryBaseTime);
+    store.m_epgEntryEndTimes[i] = ToRelativeTime(store.m_epgEntries[i].GetEndTime(), store.m_epgEntryBaseTime);
+  }
+
+  store.m_epgEntryTimesBuilt = true;
+}
+
+size_t ChannelEpg::FindFirstEpgEntryEndingAfter(time_t time, int timeShift)
+{
+  SortEpgEntries();
+
+  if (m_epgEntryCount == 0)
+    return 0;
+
+  // The entries are only sorted by start time, but no entry starting before the time less the
+  // longest duration can end after it, so everything before that can be skipped
+  const time_t earliestStartTime = time - m_epgEntryStore->m_maxEpgEntryDuration - timeShift;
+
+  size_t first = 0;
+  size_t count = m_epgEntryCount;
+  while (count > 0)
+  {
+    const size_t step = count / 2;
+    if (GetEpgEntryStartTime(first + step) < earliestStartTime)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+
+  return first;
+}
+
+size_t ChannelEpg::LimitEpgEntries(size_t maxCount, time_t time)
+{
+  SortEpgEntries();
+
+  if (m_epgEntryCount <= maxCount)
+    return 0;
+
+  const size_t removedCount = m_epgEntryCount - maxCount;
+
+  // If there are not enough entries after the time the ones just before it are kept too
+  size_t first = FindFirstEpgEntryEndingAfter(time, 0);
+  while (first < m_epgEntryCount && GetEpgEntryEndTime(first) <= time)
+    first++;
+  first = std::min(first, m_epgEntryCount - maxCount);
+
+  // Other channel EPGs still use the rest of a shared store so only our range changes, as when
+  // pruned, and CompactEpgEntryStores() frees the entries once none of them use them
+  if (m_sharesEpgEntries || m_epgEntryStore.use_count() > 1)
+  {
+    m_firstEpgEntry += static_cast<std::ptrdiff_t>(first);
+    m_epgEntryCount = maxCount;
+    return removedCount;
+  }
+
+  // Our entries keep their order in a store of our own so the range to keep is the same
+  MakeEpgEntryStoreUnique();
+  SortEpgEntries();
+
+  std::vector<EpgEntry>& epgEntries = m_epgEntryStore->m_epgEntries;
+  epgEntries.erase(epgEntries.begin() + first + maxCount, epgEntries.end());
+  epgEntries.erase(epgEntries.begin(), epgEntries.begin() + first);
+  epgEntries.shrink_to_fit();
+
+  m_epgEntryCount = epgEntries.size();
+  BuildEpgEntryTimes();
+
+  return removedCount;
+}
+
+size_t ChannelEpg::PruneEpgEntries(time_t start, time_t end)
+{
+  SortEpgEntries();
+
+  // Entries starting before one which ends after the start are kept so this only looks at the ends
+  size_t first = 0;
+  while (first < m_epgEntryCount && GetEpgEntryEndTime(first) < start)
+    first++;
+
+  size_t last = m_epgEntryCount;
+  while (last > first && GetEpgEntryStartTime(last - 1) > end)
+    last--;
+
+  const size_t removedCount = m_epgEntryCount - (last - first);
+  m_firstEpgEntry += static_cast<std::ptrdiff_t>(first);
+  m_epgEntryCount = last - first;
+
+  return removedCount;
+}
+
+void ChannelEpg::CompactEpgEntryStores(std::vector<ChannelEpg>& channelEpgs)
+{
+  struct UsedRange
+  {
+    ChannelEpg* m_channelEpg;
+    size_t m_first;
+    size_t m_last;
+  };
+
+  // The range of each store used by any of the channel EPGs
+  std::unordered_map<EpgEntryStore*, UsedRange> usedRanges;
+  for (auto& channelEpg : channelEpgs)
+  {
+    if (!channelEpg.m_epgEntryStore)
+      continue;
+
+    UsedRange& usedRange = usedRanges.emplace(channelEpg.m_epgEntryStore.get(),
+                                              UsedRange{&channelEpg, std::numeric_limits<size_t>::max(), 0}).first->second;
+    if (channelEpg.m_epgEntryCount > 0)
+    {
+      usedRange.m_first = std::min(usedRange.m_first, channelEpg.ToStoreIndex(0));
+      usedRange.m_last = std::max(usedRange.m_last, channelEpg.ToStoreIndex(channelEpg.m_epgEntryCount));
+    }
+  }
+
+  for (auto& storeUsedRange : usedRanges)
+  {
+    EpgEntryStore& store = *storeUsedRange.first;
+    UsedRange& usedRange = storeUsedRange.second;
+    if (usedRange.m_first > usedRange.m_last)
+      usedRange.m_first = usedRange.m_last = 0;
+
+    // The entries are only moved once a good part of the store is unused
+    const size_t usedCount = usedRange.m_last - usedRange.m_first;
+    if (usedCount * 2 > store.m_epgEntries.size())
+      continue;
+
+    std::vector<EpgEntry>& epgEntries = store.m_epgEntries;
+    epgEntries.erase(epgEntries.begin() + usedRange.m_last, epgEntries.end());
+    epgEntries.erase(epgEntries.begin(), epgEntries.begin() + usedRange.m_first);
+    epgEntries.shrink_to_fit();
+    store.m_epgEntryIndexBase -= static_cast<std::ptrdiff_t>(usedRange.m_first);
+
+    // Entries are packed in order so the blocks still used are also a single range
+    uint32_t firstBlock = PackedDescriptions::NO_BLOCK;
+    uint32_t lastBlock = 0;
+    for (const auto& epgEntry : epgEntries)
+    {
+      if (epgEntry.HasPackedDescriptions())
+      {
+        firstBlock = std::min(firstBlock, epgEntry.GetPackedDescriptions().m_block);
+        lastBlock = std::max(lastBlock, epgEntry.GetPackedDescriptions().m_block);
+      }
+    }
+
+    if (firstBlock == PackedDescriptions::NO_BLOCK)
+    {
+      store.m_descriptionBlocks.clear();
+    }
+    else
+    {
+      store.m_descriptionBlocks.erase(store.m_descriptionBlocks.begin() + lastBlock + 1, store.m_descriptionBlocks.end());
+      store.m_descriptionBlocks.erase(store.m_descriptionBlocks.begin(), store.m_descriptionBlocks.begin() + firstBlock);
+      if (firstBlock > 0)
+      {
+        for (auto& epgEntry : epgEntries)
+        {
+          if (epgEntry.HasPackedDescriptions())
+            epgEntry.MovePackedDescriptions(epgEntry.GetPackedDescriptions().m_block - firstBlock);
+        }
+      }
+    }
+    store.m_descriptionBlocks.shrink_to_fit();
+
+    usedRange.m_channelEpg->BuildEpgEntryTimes();
+  }
+}
+
+bool ChannelEpg::ShareEpgEntriesFrom(ChannelEpg& channelEpg, time_t offset)
+{
+  // The store's times have to be those of the channel EPG we share with
+  if (m_epgEntryCount == 0 || m_sharesEpgEntries || channelEpg.GetEpgEntryCount() == 0 || channelEpg.m_epgEntryOffset != 0 ||
+      m_epgEntryStore == channelEpg.m_epgEntryStore)
+    return false;
+
+  SortEpgEntries();
+  channelEpg.SortEpgEntries();
+
+  EpgEntryStore& store = *channelEpg.m_epgEntryStore;
+  if (!store.m_descriptionBlocks.empty() || !m_epgEntryStore->m_descriptionBlocks.empty())
+    return false;
+
+  auto getEntry = [this](size_t index) -> const EpgEntry& { return m_epgEntryStore->m_epgEntries[ToStoreIndex(index)]; };
+  const size_t storeCount = store.m_epgEntries.size();
+
+  // Line up our entries with the store, only one of the two can start first
+  size_t storeFirst = 0;
+  while (storeFirst < storeCount && store.m_epgEntries[storeFirst].GetStartTime() < getEntry(0).GetStartTime() - offset)
+    storeFirst++;
+
+  size_t ourFirst = 0;
+  while (ourFirst < m_epgEntryCount && getEntry(ourFirst).GetStartTime() - offset < store.m_epgEntries.front().GetStartTime())
+    ourFirst++;
+
+  // Most of the entries have to be in common for it to be worth sharing them
+  const size_t commonCount = std::min(storeCount - storeFirst, m_epgEntryCount - ourFirst);
+  if (commonCount == 0 || commonCount * 2 < m_epgEntryCount)
+    return false;
+
+  for (size_t i = 0; i < commonCount; i++)
+  {
+    const EpgEntry& ourEntry = getEntry(ourFirst + i);
+    const EpgEntry& storeEntry = store.m_epgEntries[storeFirst + i];
+    if (ourEntry.GetStartTime() - offset != storeEntry.GetStartTime() || ourEntry.GetEndTime() - offset != storeEntry.GetEndTime() ||
+        !ourEntry.IsSameProgrammeAs(storeEntry))
+      return false;
+  }
+
+  // Entries only we have, before or after the common ones, are added to the store with its times
+  auto toStoreEntry = [&store, offset](EpgEntry epgEntry)
+  {
+    epgEntry.SetStartTime(epgEntry.GetStartTime() - offset);
+    epgEntry.SetEndTime(epgEntry.GetEndTime() - offset);
+    epgEntry.SetBroadcastId(epgEntry.GetBroadcastId() - static_cast<int>(offset));
+    store.m_maxEpgEntryDuration = std::max(store.m_maxEpgEntryDuration, epgEntry.GetEndTime() - epgEntry.GetStartTime());
+    return epgEntry;
+  };
+
+  std::vector<EpgEntry> extraEpgEntries;
+  for (size_t i = 0; i < ourFirst; i++)
+    extraEpgEntries.emplace_back(toStoreEntry(getEntry(i)));
+  store.m_epgEntries.insert(store.m_epgEntries.begin(), extraEpgEntries.begin(), extraEpgEntries.end());
+  store.m_epgEntryIndexBase += static_cast<std::ptrdiff_t>(ourFirst);
+
+  for (size_t i = ourFirst + commonCount; i < m_epgEntryCount; i++)
+    store.m_epgEntries.emplace_back(toStoreEntry(getEntry(i)));
+
+  if (ourFirst > 0 || ourFirst + commonCount < m_epgEntryCount)
+    channelEpg.BuildEpgEntryTimes();
+
+  // If we start first our entries start at the front of the store
+  const size_t ourStoreIndex = ourFirst > 0 ? 0 : storeFirst;
+  m_firstEpgEntry = static_cast<std::ptrdiff_t>(ourStoreIndex) - store.m_epgEntryIndexBase;
+  m_epgEntryOffset = offset;
+  m_sharesEpgEntries = true;
+  m_epgEntryStore = channelEpg.m_epgEntryStore;
+
+  return true;
+}
+
+void ChannelEpg::CompressEpgEntryDescriptions()
+{
+  if (!m_epgEntryStore)
+    return;
+
+  EpgEntryStore& store = *m_epgEntryStore;
+  std::string text;
+  std::vector<std::pair<size_t, uint32_t>> pendingEntries; // Entry index and offset in the text
+
+  auto compressBlock = [&]()
+  {
+    if (text.empty())
+      return;
+
+    DescriptionBlock block;
+    block.m_id = nextDescriptionBlockId++;
+    block.m_size = static_cast<uint32_t>(text.size());
+    block.m_data.resize(compressBound(text.size()));
+
+    uLongf compressedSize = block.m_data.size();
+    if (compress2(reinterpret_cast<Bytef*>(&block.m_data[0]), &compressedSize,
+                  reinterpret_cast<const Bytef*>(text.c_str()), text.size(), Z_BEST_SPEED) == Z_OK)
+    {
+      block.m_data.resize(compressedSize);
+      block.m_data.shrink_to_fit();
+
+      for (const auto& pendingEntry : pendingEntries)
+        store.m_epgEntries[pendingEntry.first].PackDescriptions(static_cast<uint32_t>(store.m_descriptionBlocks.size()), pendingEntry.second);
+
+      store.m_descriptionBytes += text.size();
+      store.m_compressedDescriptionBytes += block.m_data.size();
+      store.m_descriptionBlocks.emplace_back(std::move(block));
+    }
+    else
+    {
+      // The entries simply keep their own copies
+      Logger::Log(LEVEL_ERROR, "%s - Unable to compress EPG descriptions for channel EPG with id '%s'", __FUNCTION__, m_id.c_str());
+    }
+
+    text.clear();
+    pendingEntries.clear();
+  };
+
+  // All of the store's entries are packed, including those only used by channels sharing it
+  for (size_t i = 0; i < store.m_epgEntries.size(); i++)
+  {
+    const EpgEntry& epgEntry = store.m_epgEntries[i];
+    if (epgEntry.HasPackedDescriptions() || (epgEntry.GetPlot().empty() && epgEntry.GetPlotOutline().empty()))
+      continue;
+
+    pendingEntries.emplace_back(i, static_cast<uint32_t>(text.size()));
+    text.append(epgEntry.GetPlot());
+    text.append(epgEntry.GetPlotOutline());
+
+    if (text.size() >= DESCRIPTION_BLOCK_SIZE)
+      compressBlock();
+  }
+
+  compressBlock();
+}
+
+bool ChannelEpg::GetEpgEntryDescriptions(size_t index, std::string& plot, std::string& plotOutline) const
+{
+  const PackedDescriptions& packedDescriptions = m_epgEntryStore->m_epgEntries[ToStoreIndex(index)].GetPackedDescriptions();
+  if (packedDescriptions.m_block == PackedDescriptions::NO_BLOCK)
+    return false;
+
+  const DescriptionBlock& block = m_epgEntryStore->m_descriptionBlocks[packedDescriptions.m_block];
+
+  std::lock_guard<std::mutex> lock(decodedBlocksMutex);
+
+  DecodedBlock* decodedBlock = nullptr;
+  for (auto& cachedBlock : decodedBlocks)
+  {
+    if (cachedBlock.m_id == block.m_id)
+    {
+      decodedBlock = &cachedBlock;
+      break;
+    }
+
+    if (!decodedBlock || cachedBlock.m_lastUsed < decodedBlock->m_lastUsed)
+      decodedBlock = &cachedBlock;
+  }
+
+  if (decodedBlock->m_id != block.m_id)
+  {
+    decodedBlock->m_text.resize(block.m_size);
+
+    uLongf decodedSize = block.m_size;
+    if (uncompress(reinterpret_cast<Bytef*>(&decodedBlock->m_text[0]), &decodedSize,
+                   reinterpret_cast<const Bytef*>(block.m_data.c_str()), block.m_data.size()) != Z_OK ||
+        decodedSize != block.m_size)
+    {
+      Logger::Log(LEVEL_ERROR, "%s - Unable to decompress EPG descriptions for channel EPG with id '%s'", __FUNCTION__, m_id.c_str());
+      decodedBlock->m_id = 0;
+      plot.clear();
+      plotOutline.clear();
+      return true;
+    }
+
+    decodedBlock->m_id = block.m_id;
+  }
+
+  decodedBlock->m_lastUsed = ++decodedBlockUseCount;
+
+  plot.assign(decodedBlock->m_text, packedDescriptions.m_offset, packedDescriptions.m_plotLength);
+  plotOutline.assign(decodedBlock->m_text, packedDescriptions.m_offset + packedDescriptions.m_plotLength, packedDescriptions.m_plotOutlineLength);
+
+  return true;
+}
+
+void ChannelEpg::AddDeferredProgramme(size_t offset, size_t length)
+{
+  // A channel's programmes are normally next to each other so most ranges can be joined up
+  if (!m_deferredProgrammes.empty() && m_deferredProgrammes.back().first + m_deferredProgrammes.back().second == offset)
+    m_deferredProgrammes.back().second += length;
+  else
+    m_deferredProgrammes.emplace_back(offset, length);
+}
+
+void ChannelEpg::SortLaterProgrammes()
+{
+  std::stable_sort(m_laterProgrammes.begin(), m_laterProgrammes.end(), [](const LaterProgramme& left, const LaterProgramme& right)
+  {
+    return left.m_startTime < right.m_startTime;
+  });
+}
+
+bool ChannelEpg::TakeLaterProgrammes(time_t time, std::vector<LaterProgramme>& programmes)
+{
+  auto laterProgrammesEnd = std::upper_bound(m_laterProgrammes.begin(), m_laterProgrammes.end(), time, [](time_t time, const LaterProgramme& programme)
+  {
+    return time < programme.m_startTime;
+  });
+
+  if (laterProgrammesEnd == m_laterProgrammes.begin())
+    return false;
+
+  programmes.assign(m_laterProgrammes.begin(), laterProgrammesEnd);
+  m_laterProgrammes.erase(m_laterProgrammes.begin(), laterProgrammesEnd);
+
+  return true;
+}
+
 void ChannelEpg::AddDisplayName(const std::string& value)
 {
   DisplayNamePair pair;
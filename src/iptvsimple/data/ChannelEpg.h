@@ -11,9 +11,15 @@
 #include "../Media.h"
 #include "EpgEntry.h"
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include <kodi/addon-instance/pvr/EPG.h>
 #include <pugixml.hpp>
 
 namespace iptvsimple
@@ -39,8 +45,66 @@ namespace iptvsimple
       const std::string& GetIconPath() const { return m_iconPath; }
       void SetIconPath(const std::string& value) { m_iconPath = value; }
 
-      std::map<time_t, EpgEntry>& GetEpgEntries() { return m_epgEntries; }
-      void AddEpgEntry(const EpgEntry& epgEntry) { m_epgEntries[epgEntry.GetStartTime()] = epgEntry; }
+      size_t GetEpgEntryCount() const { return m_epgEntryCount; }
+      // The stored entry, which is shared with any other channel EPG sharing the entries so only
+      // for changes that apply to all of them. Its times do not include the offset of this channel.
+      EpgEntry& GetEpgEntry(size_t index) { return m_epgEntryStore->m_epgEntries[ToStoreIndex(index)]; }
+      // A copy of the entry as it is for this channel, with its own times and descriptions
+      EpgEntry CopyEpgEntry(size_t index) const;
+      void UpdateEpgEntryTo(size_t index, kodi::addon::PVREPGTag& tag, int channelUid, int timeShift) const;
+      time_t GetEpgEntryStartTime(size_t index) const;
+      time_t GetEpgEntryEndTime(size_t index) const;
+      void AddEpgEntry(const EpgEntry& epgEntry);
+      // Add the entries of a channel EPG of later programmes with our own times, which keeps using
+      // a shared store for those which follow on from ours and are the same for all that use it
+      void AddLaterEpgEntriesFrom(ChannelEpg& channelEpg);
+      void SortEpgEntries();
+      size_t FindFirstEpgEntryEndingAfter(time_t time, int timeShift);
+      // Keep at most maxCount entries, from the one on at the time onwards, returns how many were removed
+      size_t LimitEpgEntries(size_t maxCount, time_t time);
+      // Stop using the entries ending before start or starting after end, returns how many there were. The
+      // entries are only freed by CompactEpgEntryStores() as other channel EPGs may still be using them.
+      size_t PruneEpgEntries(time_t start, time_t end);
+      // Free the entries, and their description blocks, no longer used by any of the channel EPGs
+      static void CompactEpgEntryStores(std::vector<ChannelEpg>& channelEpgs);
+
+      // Move the descriptions of the entries not yet packed into compressed blocks
+      void CompressEpgEntryDescriptions();
+      // Get the descriptions of a packed entry, false if the entry's own are still in use
+      bool GetEpgEntryDescriptions(size_t index, std::string& plot, std::string& plotOutline) const;
+      size_t GetDescriptionBytes() const { return m_epgEntryStore ? m_epgEntryStore->m_descriptionBytes : 0; }
+      size_t GetCompressedDescriptionBytes() const { return m_epgEntryStore ? m_epgEntryStore->m_compressedDescriptionBytes : 0; }
+
+      /*
+       * Use the entries of another channel EPG instead of our own when the two schedules are
+       * the same but for a constant offset, e.g. timeshift (+1) and regional variants. Where the
+       * schedules overlap every entry must match, entries only one of them has at either end
+       * are added to the shared entries. Both must be sorted and their descriptions not yet
+       * compressed. Returns false, leaving our own entries in place, if they don't match.
+       */
+      bool ShareEpgEntriesFrom(ChannelEpg& channelEpg, time_t offset);
+      bool SharesEpgEntries() const { return m_sharesEpgEntries; }
+
+      const std::vector<std::pair<size_t, size_t>>& GetDeferredProgrammes() const { return m_deferredProgrammes; }
+      void AddDeferredProgramme(size_t offset, size_t length);
+      bool HasDeferredProgrammes() const { return !m_deferredProgrammes.empty(); }
+      void ClearDeferredProgrammes() { std::vector<std::pair<size_t, size_t>>().swap(m_deferredProgrammes); }
+
+      // Where the markup of a programme starting after the window loaded is, kept so the window
+      // can be moved on later without loading the EPG again
+      struct LaterProgramme
+      {
+        time_t m_startTime;
+        size_t m_offset;
+        size_t m_length;
+      };
+
+      std::vector<LaterProgramme>& GetLaterProgrammes() { return m_laterProgrammes; }
+      void AddLaterProgramme(time_t startTime, size_t offset, size_t length) { m_laterProgrammes.push_back({startTime, offset, length}); }
+      void SortLaterProgrammes();
+      // Move the programmes starting at or before the time into programmes, false if there are none
+      bool TakeLaterProgrammes(time_t time, std::vector<LaterProgramme>& programmes);
+      void ClearLaterProgrammes() { std::vector<LaterProgramme>().swap(m_laterProgrammes); }
 
       bool UpdateFrom(const pugi::xml_node& channelNode, iptvsimple::Channels& channels, iptvsimple::Media& media);
       bool CombineNamesAndIconPathFrom(const ChannelEpg& right);
@@ -49,7 +113,60 @@ namespace iptvsimple
       std::string m_id;
       std::vector<DisplayNamePair> m_displayNames;
       std::string m_iconPath;
-      std::map<time_t, EpgEntry> m_epgEntries;
+
+      // Descriptions of the entries packed together and compressed with zlib. The id is unique
+      // across all channels and loads so decoded blocks can be cached without going stale.
+      struct DescriptionBlock
+      {
+        uint64_t m_id;
+        uint32_t m_size;
+        std::string m_data;
+      };
+
+      struct EpgEntryStore
+      {
+        // Kept sorted by start time with unique start times once SortEpgEntries() is called. The
+        // start/end times are also held in separate arrays as 32 bit offsets from a base time so
+        // that lookups only touch a few cache lines rather than every entry. Times too far from
+        // the base to fit are saturated and read from the entry itself instead.
+        std::vector<EpgEntry> m_epgEntries;
+        std::vector<int32_t> m_epgEntryStartTimes;
+        std::vector<int32_t> m_epgEntryEndTimes;
+        time_t m_epgEntryBaseTime = 0;
+        bool m_epgEntriesSorted = true;
+        bool m_epgEntryTimesBuilt = true;
+        time_t m_maxEpgEntryDuration = 0;
+
+        // Where the first entry was when the store was created. Moved as entries are added to or
+        // removed from the front so the ranges of the channel EPGs using the store stay the same.
+        std::ptrdiff_t m_epgEntryIndexBase = 0;
+
+        std::vector<DescriptionBlock> m_descriptionBlocks;
+        size_t m_descriptionBytes = 0;
+        size_t m_compressedDescriptionBytes = 0;
+      };
+
+      size_t ToStoreIndex(size_t index) const
+      {
+        return static_cast<size_t>(m_epgEntryStore->m_epgEntryIndexBase + m_firstEpgEntry) + index;
+      }
+      void MakeEpgEntryStoreUnique();
+      void BuildEpgEntryTimes();
+
+      // Our entries are the m_epgEntryCount entries of the store from m_firstEpgEntry, relative to
+      // where the store started, with m_epgEntryOffset added to their times. Unless the store is
+      // shared that is all of its entries with no offset. Created with the first entry added.
+      std::shared_ptr<EpgEntryStore> m_epgEntryStore;
+      std::ptrdiff_t m_firstEpgEntry = 0;
+      size_t m_epgEntryCount = 0;
+      time_t m_epgEntryOffset = 0;
+      bool m_sharesEpgEntries = false;
+
+      // Offset/length of the markup of programmes yet to be parsed when loading on demand
+      std::vector<std::pair<size_t, size_t>> m_deferredProgrammes;
+
+      // Programmes after the window loaded, by start time once SortLaterProgrammes() is called
+      std::vector<LaterProgramme> m_laterProgrammes;
     };
   } //namespace data
 } //namespace iptvsimple
@@ -10,10 +10,11 @@
 #include "../Settings.h"
 #include "../utilities/TimeUtils.h"
 #include "../utilities/XMLUtils.h"
+#include "../utilities/XmltvScanUtils.h"
 
 #include <cmath>
 #include <cstdlib>
-#include <regex>
+#include <cstring>
 
 #include <kodi/tools/StringUtils.h>
 #include <pugixml.hpp>
@@ -21,9 +22,10 @@
 using namespace kodi::tools;
 using namespace iptvsimple;
 using namespace iptvsimple::data;
+using namespace iptvsimple::utilities;
 using namespace pugi;
 
-void EpgEntry::UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeShift, const std::vector<EpgGenre>& genreMappings)
+void EpgEntry::UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeShift) const
 {
   left.SetUniqueBroadcastId(m_broadcastId);
   left.SetTitle(m_title);
@@ -37,7 +39,7 @@ void EpgEntry::UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeS
   left.SetWriter(m_writer);
   left.SetYear(m_year);
   left.SetIconPath(m_iconPath);
-  if (SetEpgGenre(genreMappings))
+  if (m_genreMapped)
   {
     left.SetGenreType(m_genreType);
     if (Settings::GetInstance().UseEpgGenreTextWhenMapping())
@@ -50,53 +52,81 @@ void EpgEntry::UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeS
     else
     {
       left.SetGenreSubType(m_genreSubType);
+      left.SetGenreDescription("");
     }
   }
   else
   {
     left.SetGenreType(EPG_GENRE_USE_STRING);
+    left.SetGenreSubType(0);
     left.SetGenreDescription(m_genreString);
   }
-  if (m_parentalRatingSystem.empty())
-    left.SetParentalRatingCode(m_parentalRating);
-  else
-    left.SetParentalRatingCode(m_parentalRatingSystem + "-" + m_parentalRating);
+  left.SetParentalRatingCode(m_parentalRatingCode);
   left.SetStarRating(m_starRating);
   left.SetSeriesNumber(m_seasonNumber);
   left.SetEpisodeNumber(m_episodeNumber);
   left.SetEpisodePartNumber(m_episodePartNumber);
   left.SetEpisodeName(m_episodeName);
   left.SetFirstAired(m_firstAired);
-  int iFlags = EPG_TAG_FLAG_UNDEFINED;
-  if (m_new)
-    iFlags |= EPG_TAG_FLAG_IS_NEW;
-  if (m_premiere)
-    iFlags |= EPG_TAG_FLAG_IS_PREMIERE;
-  left.SetFlags(iFlags);
+  left.SetFlags(m_flags);
 }
 
-bool EpgEntry::SetEpgGenre(const std::vector<EpgGenre> genreMappings)
+void EpgEntry::SetGenreMapping(const EpgGenre* genreMapping)
 {
-  if (genreMappings.empty())
-    return false;
-
-  for (const auto& genre : StringUtils::Split(m_genreString, EPG_STRING_TOKEN_SEPARATOR))
+  m_genreMapped = genreMapping != nullptr;
+  if (genreMapping)
   {
-    if (genre.empty())
-      continue;
-
-    for (const auto& genreMapping : genreMappings)
-    {
-      if (StringUtils::EqualsNoCase(genreMapping.GetGenreString(), genre))
-      {
-        m_genreType = genreMapping.GetGenreType();
-        m_genreSubType = genreMapping.GetGenreSubType();
-        return true;
-      }
-    }
+    m_genreType = genreMapping->GetGenreType();
+    m_genreSubType = genreMapping->GetGenreSubType();
   }
+}
 
-  return false;
+void EpgEntry::PackDescriptions(uint32_t block, uint32_t offset)
+{
+  m_packedDescriptions.m_block = block;
+  m_packedDescriptions.m_offset = offset;
+  m_packedDescriptions.m_plotLength = static_cast<uint32_t>(m_plot.size());
+  m_packedDescriptions.m_plotOutlineLength = static_cast<uint32_t>(m_plotOutline.size());
+
+  std::string().swap(m_plot);
+  std::string().swap(m_plotOutline);
+}
+
+void EpgEntry::UnpackDescriptions(const std::string& plot, const std::string& plotOutline)
+{
+  m_packedDescriptions = PackedDescriptions();
+  m_plot = plot;
+  m_plotOutline = plotOutline;
+}
+
+bool EpgEntry::IsSameProgrammeAs(const EpgEntry& right) const
+{
+  return m_title == right.m_title &&
+         m_episodeName == right.m_episodeName &&
+         m_plot == right.m_plot &&
+         m_plotOutline == right.m_plotOutline &&
+         m_genreString == right.m_genreString &&
+         m_genreType == right.m_genreType &&
+         m_genreSubType == right.m_genreSubType &&
+         m_genreMapped == right.m_genreMapped &&
+         m_year == right.m_year &&
+         m_episodeNumber == right.m_episodeNumber &&
+         m_episodePartNumber == right.m_episodePartNumber &&
+         m_seasonNumber == right.m_seasonNumber &&
+         m_firstAired == right.m_firstAired &&
+         m_iconPath == right.m_iconPath &&
+         m_cast == right.m_cast &&
+         m_director == right.m_director &&
+         m_writer == right.m_writer &&
+         m_parentalRating == right.m_parentalRating &&
+         m_parentalRatingSystem == right.m_parentalRatingSystem &&
+         m_parentalRatingIconPath == right.m_parentalRatingIconPath &&
+         m_parentalRatingCode == right.m_parentalRatingCode &&
+         m_starRating == right.m_starRating &&
+         m_new == right.m_new &&
+         m_premiere == right.m_premiere &&
+         m_flags == right.m_flags &&
+         m_catchupId == right.m_catchupId;
 }
 
 namespace
@@ -126,6 +156,55 @@ long long GetUTCTime(int year, int mon, int mday, int hour, int min, int sec)
   return (((MakeTime(y, m, mday) - MakeTime(1970 + 99, 12, 1)) * 24 + hour) * 60 + min) * 60 + sec;
 }
 
+// As "%0<width>d" with printf()
+void AppendPaddedInt(std::string& text, int value, int width)
+{
+  unsigned int number = value < 0 ? 0u - static_cast<unsigned int>(value) : static_cast<unsigned int>(value);
+  char digits[16];
+  int digitCount = 0;
+  do
+  {
+    digits[digitCount++] = static_cast<char>('0' + number % 10);
+    number /= 10;
+  } while (number > 0);
+
+  if (value < 0)
+  {
+    text += '-';
+    width--;
+  }
+
+  for (int padding = width - digitCount; padding > 0; padding--)
+    text += '0';
+
+  while (digitCount > 0)
+    text += digits[--digitCount];
+}
+
+std::string FormatW3CDate(int year, int mon, int mday)
+{
+  std::string w3cDate;
+  w3cDate.reserve(10);
+
+  AppendPaddedInt(w3cDate, year, 4);
+  w3cDate += '-';
+  AppendPaddedInt(w3cDate, mon, 2);
+  w3cDate += '-';
+  AppendPaddedInt(w3cDate, mday, 2);
+
+  return w3cDate;
+}
+
+long long GetUTCTime(int year, int mon, int mday, int hour, int min, int sec, char offsetSign, int offsetHours, int offsetMinutes)
+{
+  long offset_of_date = (offsetHours * 60 + offsetMinutes) * 60;
+  if (offsetSign == '-')
+    offset_of_date = -offset_of_date;
+
+  return GetUTCTime(year, mon, mday, hour, min, sec) - offset_of_date;
+}
+
+// Parses an XMLTV date time of the form "YYYYMMDDhhmmss +zzzz" where any trailing fields are optional
 long long ParseDateTime(const std::string& strDate)
 {
   int year = 2000;
@@ -138,13 +217,35 @@ long long ParseDateTime(const std::string& strDate)
   int offset_hours = 0;
   int offset_minutes = 0;
 
-  std::sscanf(strDate.c_str(), "%04d%02d%02d%02d%02d%02d %c%02d%02d", &year, &mon, &mday, &hour, &min, &sec, &offset_sign, &offset_hours, &offset_minutes);
+  const char* position = strDate.c_str();
+  if (XmltvScanUtils::ScanDate(position, year, mon, mday))
+    XmltvScanUtils::ScanTime(position, hour, min, sec, offset_sign, offset_hours, offset_minutes);
 
-  long offset_of_date = (offset_hours * 60 + offset_minutes) * 60;
-  if (offset_sign == '-')
-    offset_of_date = -offset_of_date;
+  return GetUTCTime(year, mon, mday, hour, min, sec, offset_sign, offset_hours, offset_minutes);
+}
 
-  return GetUTCTime(year, mon, mday, hour, min, sec) - offset_of_date;
+// The same as ParseDateTime() for the date from a <date> element combined with the time and
+// offset of another XMLTV date time, i.e. the programme start
+long long ParseDateTime(const std::string& strDate, const std::string& strTimeFrom)
+{
+  int year = 2000;
+  int mon = 1;
+  int mday = 1;
+  int hour = 0;
+  int min = 0;
+  int sec = 0;
+  char offset_sign = '+';
+  int offset_hours = 0;
+  int offset_minutes = 0;
+
+  const char* position = strDate.c_str();
+  if (XmltvScanUtils::ScanDate(position, year, mon, mday))
+  {
+    position = strTimeFrom.size() > DATESTRING_LENGTH ? strTimeFrom.c_str() + DATESTRING_LENGTH : "";
+    XmltvScanUtils::ScanTime(position, hour, min, sec, offset_sign, offset_hours, offset_minutes);
+  }
+
+  return GetUTCTime(year, mon, mday, hour, min, sec, offset_sign, offset_hours, offset_minutes);
 }
 
 std::string ParseAsW3CDateString(const std::string& strDate)
@@ -153,18 +254,17 @@ std::string ParseAsW3CDateString(const std::string& strDate)
   int mon = 1;
   int mday = 1;
 
-  std::sscanf(strDate.c_str(), "%04d%02d%02d", &year, &mon, &mday);
+  const char* position = strDate.c_str();
+  XmltvScanUtils::ScanDate(position, year, mon, mday);
 
-  return StringUtils::Format("%04d-%02d-%02d", year, mon, mday);
+  return FormatW3CDate(year, mon, mday);
 }
 
 std::string ParseAsW3CDateString(time_t time)
 {
   std::tm tm = SafeLocaltime(time);
-  char buffer[16];
-  std::strftime(buffer, 16, "%Y-%m-%d", &tm);
 
-  return buffer;
+  return FormatW3CDate(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday);
 }
 
 int ParseStarRating(const std::string& starRatingString)
@@ -186,10 +286,30 @@ int ParseStarRating(const std::string& starRatingString)
   return static_cast<int>(std::round(starRating));
 }
 
+// Cut a description down to at most maxLength bytes without splitting a UTF-8 character
+void TruncateDescription(std::string& description, size_t maxLength)
+{
+  if (description.size() <= maxLength)
+    return;
+
+  size_t length = maxLength;
+  while (length > 0 && (static_cast<unsigned char>(description[length]) & 0xC0) == 0x80)
+    length--;
+
+  description.resize(length);
+  StringUtils::TrimRight(description);
+  description.append("...");
+}
+
 } // unnamed namespace
 
+long long EpgEntry::ParseXmltvDateTime(const std::string& strDate)
+{
+  return ParseDateTime(strDate);
+}
+
 bool EpgEntry::UpdateFrom(const xml_node& programmeNode, const std::string& id,
-                          int start, int end, int minShiftTime, int maxShiftTime)
+                          int start, int end, int minShiftTime, int maxShiftTime, StringPool& stringPool)
 {
   std::string strStart, strStop;
   if (!GetAttributeValue(programmeNode, "start", strStart) || !GetAttributeValue(programmeNode, "stop", strStop))
@@ -208,6 +328,7 @@ bool EpgEntry::UpdateFrom(const xml_node& programmeNode, const std::string& id,
   m_channelId = std::atoi(id.c_str());
   m_genreType = 0;
   m_genreSubType = 0;
+  m_genreMapped = false;
   m_plotOutline.clear();
   m_startTime = static_cast<time_t>(tmpStart);
   m_endTime = static_cast<time_t>(tmpEnd);
@@ -217,19 +338,23 @@ bool EpgEntry::UpdateFrom(const xml_node& programmeNode, const std::string& id,
   m_episodePartNumber = EPG_TAG_INVALID_SERIES_EPISODE;
   m_seasonNumber = EPG_TAG_INVALID_SERIES_EPISODE;
 
-  m_title = GetNodeValue(programmeNode, "title");
+  // Elements which are not wanted are never looked up, so none of their text is copied
+  const Settings& settings = Settings::GetInstance();
+
+  m_title = stringPool.Intern(GetNodeValue(programmeNode, "title"));
   m_plot = GetNodeValue(programmeNode, "desc");
-  m_episodeName = GetNodeValue(programmeNode, "sub-title");
+  if (settings.GetEpgMaxDescriptionLength() > 0)
+    TruncateDescription(m_plot, settings.GetEpgMaxDescriptionLength());
+  m_episodeName = stringPool.Intern(GetNodeValue(programmeNode, "sub-title"));
 
-  m_genreString = GetJoinedNodeValues(programmeNode, "category");
+  m_genreString = stringPool.Intern(GetJoinedNodeValues(programmeNode, "category"));
 
   const std::string dateString = GetNodeValue(programmeNode, "date");
   if (!dateString.empty())
   {
-    static const std::regex dateRegex("^[1-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]");
-    if (std::regex_match(dateString, dateRegex))
+    if (XmltvScanUtils::IsXmltvDate(dateString))
     {
-      long long tmpDate = ParseDateTime(dateString.substr(0, DATESTRING_LENGTH) + strStart.substr(DATESTRING_LENGTH));
+      long long tmpDate = ParseDateTime(dateString, strStart);
       // Protect against negative time_t which can crash on some platforms such as localtime_s on Windows
       if (tmpDate < 0)
       {
@@ -243,26 +368,33 @@ bool EpgEntry::UpdateFrom(const xml_node& programmeNode, const std::string& id,
       }
     }
 
-    std::sscanf(dateString.c_str(), "%04d", &m_year);
+    const char* yearPosition = dateString.c_str();
+    XmltvScanUtils::ScanInt(yearPosition, 4, m_year);
   }
 
   const auto& parentalRatingNode = programmeNode.child("rating");
   if (parentalRatingNode)
   {
-    m_parentalRating = GetNodeValue(parentalRatingNode, "value");
-    GetAttributeValue(parentalRatingNode, "system", m_parentalRatingSystem);
+    m_parentalRating = stringPool.Intern(GetNodeValue(parentalRatingNode, "value"));
+
+    std::string parentalRatingSystem;
+    GetAttributeValue(parentalRatingNode, "system", parentalRatingSystem);
+    m_parentalRatingSystem = stringPool.Intern(parentalRatingSystem);
 
-    const auto& ratingIconNode = programmeNode.child("icon");
+    const auto& ratingIconNode = settings.LoadEpgProgrammeIcons() ? programmeNode.child("icon") : xml_node();
     std::string ratingIconPath;
     if (!ratingIconNode || !GetAttributeValue(ratingIconNode, "src", ratingIconPath))
       m_parentalRatingIconPath = "";
     else
-      m_parentalRatingIconPath = ratingIconPath;
+      m_parentalRatingIconPath = stringPool.Intern(ratingIconPath);
   }
 
-  const auto& starRatingNode = programmeNode.child("star-rating");
-  if (starRatingNode)
-    m_starRating = ParseStarRating(GetNodeValue(starRatingNode, "value"));
+  if (settings.LoadEpgStarRatings())
+  {
+    const auto& starRatingNode = programmeNode.child("star-rating");
+    if (starRatingNode)
+      m_starRating = ParseStarRating(GetNodeValue(starRatingNode, "value"));
+  }
 
   const auto& newNode = programmeNode.child("new");
   if (newNode)
@@ -290,20 +422,33 @@ bool EpgEntry::UpdateFrom(const xml_node& programmeNode, const std::string& id,
       m_year = 0;
   }
 
-  const auto& creditsNode = programmeNode.child("credits");
+  const auto& creditsNode = settings.LoadEpgCredits() ? programmeNode.child("credits") : xml_node();
   if (creditsNode)
   {
-    m_cast = GetJoinedNodeValues(creditsNode, "actor");
-    m_director = GetJoinedNodeValues(creditsNode, "director");
-    m_writer = GetJoinedNodeValues(creditsNode, "writer");
+    m_cast = stringPool.Intern(GetJoinedNodeValues(creditsNode, "actor"));
+    m_director = stringPool.Intern(GetJoinedNodeValues(creditsNode, "director"));
+    m_writer = stringPool.Intern(GetJoinedNodeValues(creditsNode, "writer"));
   }
 
-  const auto& iconNode = programmeNode.child("icon");
+  const auto& iconNode = settings.LoadEpgProgrammeIcons() ? programmeNode.child("icon") : xml_node();
   std::string iconPath;
   if (!iconNode || !GetAttributeValue(iconNode, "src", iconPath))
     m_iconPath = "";
   else
-    m_iconPath = iconPath;
+    m_iconPath = stringPool.Intern(iconPath);
+
+  // Values derived for the EPG tag are built here once, as this runs on the load workers
+  // instead of every time Kodi asks for the tags of a channel
+  if (m_parentalRatingSystem.empty())
+    m_parentalRatingCode = m_parentalRating;
+  else
+    m_parentalRatingCode = stringPool.Intern(m_parentalRatingSystem.Get() + "-" + m_parentalRating.Get());
+
+  m_flags = EPG_TAG_FLAG_UNDEFINED;
+  if (m_new)
+    m_flags |= EPG_TAG_FLAG_IS_NEW;
+  if (m_premiere)
+    m_flags |= EPG_TAG_FLAG_IS_PREMIERE;
 
   return true;
 }
@@ -329,30 +474,35 @@ bool EpgEntry::ParseEpisodeNumberInfo(std::vector<std::pair<std::string, std::st
 
 bool EpgEntry::ParseXmltvNsEpisodeNumberInfo(const std::string& episodeNumberString)
 {
+  // The numbers can never run into the '.' separators so there's no need to split the string
   size_t found = episodeNumberString.find(".");
   if (found != std::string::npos)
   {
-    const std::string seasonString = episodeNumberString.substr(0, found);
-    std::string episodeString = episodeNumberString.substr(found + 1);
-    std::string episodePartString;
-
-    found = episodeString.find(".");
-    if (found != std::string::npos)
-    {
-      episodePartString = episodeString.substr(found + 1);
-      episodeString = episodeString.substr(0, found);
-    }
+    const char* seasonPosition = episodeNumberString.c_str();
+    const char* episodePosition = seasonPosition + found + 1;
+    const char* episodePartPosition = std::strchr(episodePosition, '.');
 
-    if (std::sscanf(seasonString.c_str(), "%d", &m_seasonNumber) == 1)
+    if (XmltvScanUtils::ScanInt(seasonPosition, 0, m_seasonNumber))
       m_seasonNumber++;
 
-    if (std::sscanf(episodeString.c_str(), "%d", &m_episodeNumber) == 1)
+    if (XmltvScanUtils::ScanInt(episodePosition, 0, m_episodeNumber))
       m_episodeNumber++;
 
-    if (!episodePartString.empty())
+    if (episodePartPosition && *(++episodePartPosition) != '\0')
     {
+      // As sscanf() with "%d/%d"
       int totalNumberOfParts;
-      int numElementsParsed = std::sscanf(episodePartString.c_str(), "%d/%d", &m_episodePartNumber, &totalNumberOfParts);
+      int numElementsParsed = 0;
+      if (XmltvScanUtils::ScanInt(episodePartPosition, 0, m_episodePartNumber))
+      {
+        numElementsParsed++;
+        if (*episodePartPosition == '/')
+        {
+          episodePartPosition++;
+          if (XmltvScanUtils::ScanInt(episodePartPosition, 0, totalNumberOfParts))
+            numElementsParsed++;
+        }
+      }
 
       if (numElementsParsed == 2)
         m_episodePartNumber++;
@@ -366,38 +516,5 @@ bool EpgEntry::ParseXmltvNsEpisodeNumberInfo(const std::string& episodeNumberStr
 
 bool EpgEntry::ParseOnScreenEpisodeNumberInfo(const std::string& episodeNumberString)
 {
-  static const std::regex unwantedCharsRegex("[ \\txX_\\.]");
-  const std::string text = std::regex_replace(episodeNumberString, unwantedCharsRegex, "");
-
-  if (StringUtils::StartsWithNoCase(text, "S"))
-  {
-    std::smatch match;
-    static const std::regex seasonEpisodeRegex("^[sS]([0-9][0-9]*)[eE][pP]?([0-9][0-9]*)$");
-    if (std::regex_match(text, match, seasonEpisodeRegex))
-    {
-      if (match.size() == 3)
-      {
-        m_seasonNumber = std::atoi(match[1].str().c_str());
-        m_episodeNumber = std::atoi(match[2].str().c_str());
-
-        return true;
-      }
-    }
-  }
-  else if (StringUtils::StartsWithNoCase(text, "E"))
-  {
-    static const std::regex episodeOnlyRegex("^[eE][pP]?([0-9][0-9]*)$");
-    std::smatch matchEpOnly;
-    if (std::regex_match(text, matchEpOnly, episodeOnlyRegex))
-    {
-      if (matchEpOnly.size() == 2)
-      {
-        m_episodeNumber = std::atoi(matchEpOnly[1].str().c_str());
-
-        return true;
-      }
-    }
-  }
-
-  return false;
+  return XmltvScanUtils::ParseOnScreenEpisodeNumber(episodeNumberString, m_seasonNumber, m_episodeNumber);
 }
@@ -7,9 +7,11 @@
 
 #pragma once
 
+#include "../utilities/StringPool.h"
 #include "BaseEntry.h"
 #include "EpgGenre.h"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -23,6 +25,17 @@ namespace iptvsimple
     static const float STAR_RATING_SCALE = 10.0f;
     constexpr int DATESTRING_LENGTH = 8;
 
+    // Where the descriptions of an entry are once moved into a compressed block of its channel
+    struct PackedDescriptions
+    {
+      static const uint32_t NO_BLOCK = UINT32_MAX;
+
+      uint32_t m_block = NO_BLOCK;
+      uint32_t m_offset = 0;
+      uint32_t m_plotLength = 0;
+      uint32_t m_plotOutlineLength = 0;
+    };
+
     class EpgEntry : public BaseEntry
     {
     public:
@@ -41,12 +54,27 @@ namespace iptvsimple
       const std::string& GetCatchupId() const { return m_catchupId; }
       void SetCatchupId(const std::string& value) { m_catchupId = value; }
 
-      void UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeShift, const std::vector<EpgGenre>& genres);
+      // Set the genre type/sub type resolved from the genre string, nullptr if there is no mapping
+      void SetGenreMapping(const EpgGenre* genreMapping);
+
+      // Once packed the plot and plot outline are empty and have to be read from the block
+      bool HasPackedDescriptions() const { return m_packedDescriptions.m_block != PackedDescriptions::NO_BLOCK; }
+      const PackedDescriptions& GetPackedDescriptions() const { return m_packedDescriptions; }
+      void PackDescriptions(uint32_t block, uint32_t offset);
+      void MovePackedDescriptions(uint32_t block) { m_packedDescriptions.m_block = block; }
+      void UnpackDescriptions(const std::string& plot, const std::string& plotOutline);
+
+      // True if everything but the times, broadcast id and channel is the same
+      bool IsSameProgrammeAs(const EpgEntry& right) const;
+
+      void UpdateTo(kodi::addon::PVREPGTag& left, int iChannelUid, int timeShift) const;
       bool UpdateFrom(const pugi::xml_node& programmeNode, const std::string& id,
-                      int start, int end, int minShiftTime, int maxShiftTime);
+                      int start, int end, int minShiftTime, int maxShiftTime, utilities::StringPool& stringPool);
+
+      // The UTC time of an XMLTV date time such as the start of a programme
+      static long long ParseXmltvDateTime(const std::string& strDate);
 
     private:
-      bool SetEpgGenre(std::vector<EpgGenre> genreMappings);
       bool ParseEpisodeNumberInfo(std::vector<std::pair<std::string, std::string>>& episodeNumbersList);
       bool ParseXmltvNsEpisodeNumberInfo(const std::string& episodeNumberString);
       bool ParseOnScreenEpisodeNumberInfo(const std::string& episodeNumberString);
@@ -56,6 +84,10 @@ namespace iptvsimple
       time_t m_startTime;
       time_t m_endTime;
       std::string m_catchupId;
+      utilities::InternedString m_parentalRatingCode;
+      PackedDescriptions m_packedDescriptions;
+      unsigned int m_flags = EPG_TAG_FLAG_UNDEFINED;
+      bool m_genreMapped = false;
     };
   } //namespace data
 } //namespace iptvsimple
@@ -73,7 +73,7 @@ void MediaEntry::UpdateFrom(iptvsimple::data::Channel channel)
   m_inputStreamName = channel.GetInputStreamName();
 }
 
-void MediaEntry::UpdateFrom(iptvsimple::data::EpgEntry epgEntry)
+void MediaEntry::UpdateFrom(const iptvsimple::data::EpgEntry& epgEntry)
 {
   // All from Base Entry
   m_startTime = epgEntry.GetStartTime();
@@ -85,20 +85,12 @@ void MediaEntry::UpdateFrom(iptvsimple::data::EpgEntry epgEntry)
   m_episodePartNumber = epgEntry.GetEpisodePartNumber();
   m_seasonNumber = epgEntry.GetSeasonNumber();
   m_firstAired = epgEntry.GetFirstAired();
-  m_title = epgEntry.GetTitle();
-  m_episodeName = epgEntry.GetEpisodeName();
   m_plotOutline = epgEntry.GetPlotOutline();
   m_plot = epgEntry.GetPlot();
-  if (!epgEntry.GetIconPath().empty())
-    m_iconPath = epgEntry.GetIconPath();
-  m_genreString = epgEntry.GetGenreString();
-  m_cast = epgEntry.GetCast();
-  m_director = epgEntry.GetDirector();
-  m_writer = epgEntry.GetWriter();
-
-  m_parentalRating = epgEntry.GetParentalRating();
-  m_parentalRatingSystem = epgEntry.GetParentalRatingSystem();
-  m_parentalRatingIconPath = epgEntry.GetParentalRatingIconPath();
+
+  // The interned strings are shared with the EPG entry rather than copied
+  ShareTextFrom(epgEntry);
+
   m_starRating = epgEntry.GetStarRating();
 
   m_new = epgEntry.IsNew();
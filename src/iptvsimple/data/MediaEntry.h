@@ -79,7 +79,7 @@ namespace iptvsimple
       void Reset();
 
       void UpdateFrom(iptvsimple::data::Channel channel);
-      void UpdateFrom(iptvsimple::data::EpgEntry epgEntry);
+      void UpdateFrom(const iptvsimple::data::EpgEntry& epgEntry);
       void UpdateTo(kodi::addon::PVRRecording& left, bool isInVirtualMediaEntryFolder, bool haveMediaTypes);
 
     private:
@@ -0,0 +1,53 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "CharsetUtils.h"
+
+#include "ScanUtils.h"
+
+#include <atomic>
+
+#include <kodi/General.h>
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+namespace
+{
+
+std::atomic<size_t> conversionsSkipped{0};
+std::atomic<size_t> conversionsPerformed{0};
+
+} // unnamed namespace
+
+void CharsetUtils::UnknownToUTF8(std::string& text)
+{
+  if (ScanUtils::IsValidUtf8(text.c_str(), text.c_str() + text.size()))
+  {
+    conversionsSkipped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  conversionsPerformed.fetch_add(1, std::memory_order_relaxed);
+  kodi::UnknownToUTF8(text, text);
+}
+
+void CharsetUtils::ResetConversionCounts()
+{
+  conversionsSkipped = 0;
+  conversionsPerformed = 0;
+}
+
+size_t CharsetUtils::GetConversionsSkipped()
+{
+  return conversionsSkipped;
+}
+
+size_t CharsetUtils::GetConversionsPerformed()
+{
+  return conversionsPerformed;
+}
@@ -0,0 +1,28 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    class CharsetUtils
+    {
+    public:
+      // The same as kodi::UnknownToUTF8() in place, but the call into Kodi is skipped
+      // when the text is already valid UTF-8 as it would be returned unchanged anyway
+      static void UnknownToUTF8(std::string& text);
+
+      static void ResetConversionCounts();
+      static size_t GetConversionsSkipped();
+      static size_t GetConversionsPerformed();
+    };
+  } // namespace utilities
+} // namespace iptvsimple
@@ -0,0 +1,62 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ChunkQueue.h"
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+ChunkQueue::ChunkQueue(size_t maxChunks) : m_maxChunks(maxChunks > 0 ? maxChunks : 1)
+{
+}
+
+bool ChunkQueue::Push(std::string&& chunk)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_spaceAvailable.wait(lock, [this] { return m_cancelled || m_chunks.size() < m_maxChunks; });
+
+  // Once cancelled the consumer is no longer interested so the producer should stop
+  if (m_cancelled || m_closed)
+    return false;
+
+  m_chunks.emplace_back(std::move(chunk));
+  m_chunkAvailable.notify_one();
+
+  return true;
+}
+
+bool ChunkQueue::Pop(std::string& chunk)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_chunkAvailable.wait(lock, [this] { return m_cancelled || m_closed || !m_chunks.empty(); });
+
+  // Chunks still queued when the producer closes the queue are handed out before finishing
+  if (m_cancelled || m_chunks.empty())
+    return false;
+
+  chunk = std::move(m_chunks.front());
+  m_chunks.pop_front();
+  m_spaceAvailable.notify_one();
+
+  return true;
+}
+
+void ChunkQueue::Close()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_closed = true;
+  m_chunkAvailable.notify_all();
+}
+
+void ChunkQueue::Cancel()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  m_cancelled = true;
+  m_chunks.clear();
+  m_chunkAvailable.notify_all();
+  m_spaceAvailable.notify_all();
+}
@@ -0,0 +1,45 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * Bounded single producer/single consumer queue used to hand chunks of data from one
+     * thread to another, e.g. from a decompressor to a parser. The producer blocks while the
+     * queue is full so memory use is bound by the number of chunks allowed in flight.
+     */
+    class ChunkQueue
+    {
+    public:
+      ChunkQueue(size_t maxChunks);
+
+      bool Push(std::string&& chunk);
+      bool Pop(std::string& chunk);
+      void Close();
+      void Cancel();
+
+    private:
+      const size_t m_maxChunks;
+      std::deque<std::string> m_chunks;
+      bool m_closed = false;
+      bool m_cancelled = false;
+
+      std::mutex m_mutex;
+      std::condition_variable m_chunkAvailable;
+      std::condition_variable m_spaceAvailable;
+    };
+  } // namespace utilities
+} // namespace iptvsimple
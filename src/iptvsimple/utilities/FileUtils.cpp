@@ -9,6 +9,8 @@
 
 #include "../Settings.h"
 
+#include <algorithm>
+
 #include <lzma.h>
 #include <zlib.h>
 
@@ -45,40 +47,24 @@ std::string FileUtils::GetUserDataAddonFilePath(const std::string& fileName)
   return PathCombine(Settings::GetInstance().GetUserPath(), fileName);
 }
 
-int FileUtils::GetFileContents(const std::string& url, std::string& content)
+int FileUtils::GetFileContents(const std::string& url, std::string& content, const std::atomic<bool>* cancelled /* nullptr */)
 {
   content.clear();
   kodi::vfs::CFile file;
   if (file.OpenFile(url))
-  {
-    char buffer[1024];
-    while (int bytesRead = file.Read(buffer, 1024))
-      content.append(buffer, bytesRead);
-  }
+    content = ReadFileContents(file, cancelled);
 
   return content.length();
 }
 
 /*
- * This method uses zlib to decompress a gzipped file in memory.
- * Author: Andrew Lim Chong Liang
- * http://windrealm.org
+ * Decompress gzip data in memory in fixed size chunks so the consumer can work
+ * on the data without the whole of it ever being decompressed at once.
  */
-
-bool FileUtils::GzipInflate(const std::string& compressedBytes, std::string& uncompressedBytes)
+bool FileUtils::GzipInflate(const std::string& compressedBytes, const DecompressedChunkHandler& chunkHandler)
 {
   if (compressedBytes.size() == 0)
-  {
-    uncompressedBytes = compressedBytes;
     return true;
-  }
-
-  uncompressedBytes.clear();
-
-  unsigned uncompLength = compressedBytes.size();
-  const unsigned half_length = compressedBytes.size() / 2;
-
-  char* uncomp = static_cast<char*>(calloc(sizeof(char), uncompLength));
 
   z_stream strm;
   strm.next_in = (Bytef*)compressedBytes.c_str();
@@ -86,61 +72,43 @@ bool FileUtils::GzipInflate(const std::string& compressedBytes, std::string& unc
   strm.total_out = 0;
   strm.zalloc = Z_NULL;
   strm.zfree = Z_NULL;
+  strm.opaque = Z_NULL;
 
   int status = inflateInit2(&strm, 16 + MAX_WBITS);
   if (status != Z_OK)
-  {
-    free(uncomp);
     return false;
-  }
 
-  bool done = false;
-  while (!done)
-  {
-    // If our output buffer is too small
-    if (strm.total_out >= uncompLength)
-    {
-      // Increase size of output buffer
-      uncomp = static_cast<char*>(realloc(uncomp, uncompLength + half_length));
-      if (!uncomp)
-        return false;
-      uncompLength += half_length;
-    }
+  std::string chunk;
+  bool handled = true;
 
-    strm.next_out = reinterpret_cast<Bytef*>(uncomp + strm.total_out);
-    strm.avail_out = uncompLength - strm.total_out;
+  while (status == Z_OK)
+  {
+    chunk.resize(DECOMPRESS_CHUNK_SIZE);
+    strm.next_out = reinterpret_cast<Bytef*>(&chunk[0]);
+    strm.avail_out = chunk.size();
 
     // Inflate another chunk.
-    int err = inflate(&strm, Z_SYNC_FLUSH);
-    if (err == Z_STREAM_END)
-      done = true;
-    else if (err != Z_OK)
-      break;
-  }
+    status = inflate(&strm, Z_SYNC_FLUSH);
 
-  status = inflateEnd(&strm);
-  if (status != Z_OK)
-  {
-    free(uncomp);
-    return false;
+    chunk.resize(chunk.size() - strm.avail_out);
+    if (!chunk.empty() && !chunkHandler(chunk))
+    {
+      handled = false;
+      break;
+    }
   }
 
-  for (size_t i = 0; i < strm.total_out; ++i)
-    uncompressedBytes += uncomp[i];
+  // As before a truncated file is not an error, we use whatever we could decompress
+  if (handled && status != Z_STREAM_END)
+    Logger::Log(LEVEL_WARNING, "%s - gzip data is truncated or corrupt (%d), decompressed %lu bytes", __FUNCTION__, status, strm.total_out);
 
-  free(uncomp);
-  return true;
+  return inflateEnd(&strm) == Z_OK && handled;
 }
 
-bool FileUtils::XzDecompress(const std::string& compressedBytes, std::string& uncompressedBytes)
+bool FileUtils::XzDecompress(const std::string& compressedBytes, const DecompressedChunkHandler& chunkHandler)
 {
   if (compressedBytes.size() == 0)
-  {
-    uncompressedBytes = compressedBytes;
     return true;
-  }
-
-  uncompressedBytes.clear();
 
   lzma_stream strm = LZMA_STREAM_INIT;
   lzma_ret ret = lzma_stream_decoder(&strm, UINT64_MAX, LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED);
@@ -148,29 +116,43 @@ bool FileUtils::XzDecompress(const std::string& compressedBytes, std::string& un
   if (ret != LZMA_OK)
     return false;
 
-  uint8_t* in_buf = (uint8_t*) compressedBytes.c_str();
-  uint8_t out_buf[LZMA_OUT_BUF_MAX];
-  size_t out_len;
-
-  strm.next_in = in_buf;
+  strm.next_in = reinterpret_cast<const uint8_t*>(compressedBytes.c_str());
   strm.avail_in = compressedBytes.size();
-  do
+
+  std::string chunk;
+  bool handled = true;
+
+  while (ret == LZMA_OK)
   {
-    strm.next_out = out_buf;
-    strm.avail_out = LZMA_OUT_BUF_MAX;
+    chunk.resize(DECOMPRESS_CHUNK_SIZE);
+    strm.next_out = reinterpret_cast<uint8_t*>(&chunk[0]);
+    strm.avail_out = chunk.size();
+
     ret = lzma_code(&strm, LZMA_FINISH);
 
-    out_len = LZMA_OUT_BUF_MAX - strm.avail_out;
-    uncompressedBytes.append((char*) out_buf, out_len);
-    out_buf[0] = 0;
-  } while (strm.avail_out == 0);
-  lzma_end (&strm);
+    // The integrity check can't be verified but the data can still be decoded
+    if (ret == LZMA_UNSUPPORTED_CHECK)
+      ret = LZMA_OK;
 
-  return true;
+    chunk.resize(chunk.size() - strm.avail_out);
+    if (!chunk.empty() && !chunkHandler(chunk))
+    {
+      handled = false;
+      break;
+    }
+  }
+
+  if (handled && ret != LZMA_STREAM_END)
+    Logger::Log(LEVEL_WARNING, "%s - xz data is truncated or corrupt (%d), decompressed %llu bytes", __FUNCTION__, ret, static_cast<unsigned long long>(strm.total_out));
+
+  lzma_end(&strm);
+
+  return handled;
 }
 
 int FileUtils::GetCachedFileContents(const std::string& cachedName, const std::string& filePath,
-                                       std::string& contents, const bool useCache /* false */)
+                                       std::string& contents, const bool useCache /* false */,
+                                       const std::atomic<bool>* cancelled /* nullptr */)
 {
   bool needReload = false;
   const std::string cachedPath = FileUtils::GetUserDataAddonFilePath(cachedName);
@@ -193,7 +175,7 @@ int FileUtils::GetCachedFileContents(const std::string& cachedName, const std::s
 
   if (needReload)
   {
-    FileUtils::GetFileContents(filePath, contents);
+    FileUtils::GetFileContents(filePath, contents, cancelled);
 
     // write to cache
     if (useCache && contents.length() > 0)
@@ -207,7 +189,7 @@ int FileUtils::GetCachedFileContents(const std::string& cachedName, const std::s
     return contents.length();
   }
 
-  return FileUtils::GetFileContents(cachedPath, contents);
+  return FileUtils::GetFileContents(cachedPath, contents, cancelled);
 }
 
 bool FileUtils::FileExists(const std::string& file)
@@ -291,16 +273,35 @@ std::string FileUtils::GetResourceDataPath()
   return kodi::addon::GetAddonPath("/resources/data");
 }
 
-std::string FileUtils::ReadFileContents(kodi::vfs::CFile& file)
+std::string FileUtils::ReadFileContents(kodi::vfs::CFile& file, const std::atomic<bool>* cancelled /* nullptr */)
 {
   std::string fileContents;
+  ssize_t bytesRead = 0;
+
+  // Read a buffer at a time so a cancelled read stops without waiting for the rest of the file
+  auto isCancelled = [cancelled]() { return cancelled && *cancelled; };
+
+  // When the length is known read straight into a buffer of that size
+  const int64_t fileLength = file.GetLength();
+  if (fileLength > 0)
+  {
+    fileContents.resize(static_cast<size_t>(fileLength));
+
+    size_t totalBytesRead = 0;
+    while (totalBytesRead < fileContents.size() && !isCancelled() &&
+           (bytesRead = file.Read(&fileContents[totalBytesRead], std::min<size_t>(fileContents.size() - totalBytesRead, size_t{READ_BUFFER_SIZE}))) > 0)
+      totalBytesRead += bytesRead;
+
+    fileContents.resize(totalBytesRead);
+  }
 
-  char buffer[1024];
-  int bytesRead = 0;
+  // Remote files may have no length or the wrong one so read until EOF or explicit error regardless
+  std::string buffer(READ_BUFFER_SIZE, '\0');
+  while (!isCancelled() && (bytesRead = file.Read(&buffer[0], buffer.size())) > 0)
+    fileContents.append(buffer, 0, bytesRead);
 
-  // Read until EOF or explicit error
-  while ((bytesRead = file.Read(buffer, sizeof(buffer) - 1)) > 0)
-    fileContents.append(buffer, bytesRead);
+  if (isCancelled())
+    std::string().swap(fileContents);
 
   return fileContents;
 }
@@ -7,25 +7,34 @@
 
 #pragma once
 
-#include <kodi/Filesystem.h>
+#include <atomic>
+#include <functional>
 #include <string>
 
+#include <kodi/Filesystem.h>
+
 namespace iptvsimple
 {
   namespace utilities
   {
-    static const int LZMA_OUT_BUF_MAX = 409600;
+    static const size_t DECOMPRESS_CHUNK_SIZE = 256 * 1024;
+    static const size_t READ_BUFFER_SIZE = 64 * 1024;
+
+    // Called for each chunk of decompressed data, the chunk may be moved from. Return false to stop.
+    typedef std::function<bool(std::string& chunk)> DecompressedChunkHandler;
 
     class FileUtils
     {
     public:
       static std::string PathCombine(const std::string& path, const std::string& fileName);
       static std::string GetUserDataAddonFilePath(const std::string& fileName);
-      static int GetFileContents(const std::string& url, std::string& content);
-      static bool GzipInflate(const std::string& compressedBytes, std::string& uncompressedBytes);
-      static bool XzDecompress(const std::string& compressedBytes, std::string& uncompressedBytes);
+      // Reading stops with no content as soon as cancelled is set, if given
+      static int GetFileContents(const std::string& url, std::string& content, const std::atomic<bool>* cancelled = nullptr);
+      static bool GzipInflate(const std::string& compressedBytes, const DecompressedChunkHandler& chunkHandler);
+      static bool XzDecompress(const std::string& compressedBytes, const DecompressedChunkHandler& chunkHandler);
       static int GetCachedFileContents(const std::string& cachedName, const std::string& filePath,
-                                       std::string& content, const bool useCache = false);
+                                       std::string& content, const bool useCache = false,
+                                       const std::atomic<bool>* cancelled = nullptr);
       static bool FileExists(const std::string& file);
       static bool DeleteFile(const std::string& file);
       static bool CopyFile(const std::string& sourceFile, const std::string& targetFile);
@@ -34,7 +43,7 @@ namespace iptvsimple
       static std::string GetResourceDataPath();
 
     private:
-      static std::string ReadFileContents(kodi::vfs::CFile& fileHandle);
+      static std::string ReadFileContents(kodi::vfs::CFile& fileHandle, const std::atomic<bool>* cancelled = nullptr);
     };
   } // namespace utilities
 } // namespace iptvsimple
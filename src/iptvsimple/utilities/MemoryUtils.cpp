@@ -0,0 +1,34 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "MemoryUtils.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+bool MemoryUtils::GetHeapUsage(size_t& bytesInUse, size_t& bytesFree)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  const struct mallinfo2 info = mallinfo2();
+  bytesInUse = info.uordblks + info.hblkhd;
+  bytesFree = info.fordblks;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void MemoryUtils::ReleaseFreeHeapMemory()
+{
+#if defined(__GLIBC__)
+  malloc_trim(0);
+#endif
+}
@@ -0,0 +1,26 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    class MemoryUtils
+    {
+    public:
+      // Heap usage as reported by the C library, false where it is not available
+      static bool GetHeapUsage(size_t& bytesInUse, size_t& bytesFree);
+
+      // Hand free heap memory back to the OS where the C library supports it
+      static void ReleaseFreeHeapMemory();
+    };
+  } // namespace utilities
+} // namespace iptvsimple
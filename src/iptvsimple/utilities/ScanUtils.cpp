@@ -0,0 +1,306 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "ScanUtils.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define IPTV_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IPTV_SCAN_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define IPTV_SCAN_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+namespace
+{
+
+#if defined(IPTV_SCAN_AVX2) || defined(IPTV_SCAN_SSE2) || defined(IPTV_SCAN_NEON)
+#define IPTV_SCAN_VECTOR
+
+// Each kernel compares a vector of bytes at a time and turns the result into a bit mask
+// with MASK_BITS_PER_BYTE bits for every byte, the lowest bits being the first byte
+
+#if defined(IPTV_SCAN_AVX2)
+typedef __m256i Vector;
+const size_t VECTOR_SIZE = 32;
+const int MASK_BITS_PER_BYTE = 1;
+
+inline Vector Load(const char* data) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data)); }
+inline Vector Broadcast(char c) { return _mm256_set1_epi8(c); }
+inline Vector Equal(Vector left, Vector right) { return _mm256_cmpeq_epi8(left, right); }
+inline Vector Or(Vector left, Vector right) { return _mm256_or_si256(left, right); }
+inline Vector And(Vector left, Vector right) { return _mm256_and_si256(left, right); }
+inline uint64_t ToMask(Vector matches) { return static_cast<uint32_t>(_mm256_movemask_epi8(matches)); }
+inline bool HasNonAscii(Vector data) { return _mm256_movemask_epi8(data) != 0; }
+#elif defined(IPTV_SCAN_SSE2)
+typedef __m128i Vector;
+const size_t VECTOR_SIZE = 16;
+const int MASK_BITS_PER_BYTE = 1;
+
+inline Vector Load(const char* data) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)); }
+inline Vector Broadcast(char c) { return _mm_set1_epi8(c); }
+inline Vector Equal(Vector left, Vector right) { return _mm_cmpeq_epi8(left, right); }
+inline Vector Or(Vector left, Vector right) { return _mm_or_si128(left, right); }
+inline Vector And(Vector left, Vector right) { return _mm_and_si128(left, right); }
+inline uint64_t ToMask(Vector matches) { return static_cast<uint32_t>(_mm_movemask_epi8(matches)); }
+inline bool HasNonAscii(Vector data) { return _mm_movemask_epi8(data) != 0; }
+#else
+typedef uint8x16_t Vector;
+const size_t VECTOR_SIZE = 16;
+const int MASK_BITS_PER_BYTE = 4;
+
+inline Vector Load(const char* data) { return vld1q_u8(reinterpret_cast<const uint8_t*>(data)); }
+inline Vector Broadcast(char c) { return vdupq_n_u8(static_cast<uint8_t>(c)); }
+inline Vector Equal(Vector left, Vector right) { return vceqq_u8(left, right); }
+inline Vector Or(Vector left, Vector right) { return vorrq_u8(left, right); }
+inline Vector And(Vector left, Vector right) { return vandq_u8(left, right); }
+// NEON has no movemask, narrowing with a shift leaves a nibble per byte instead
+inline uint64_t ToMask(Vector matches) { return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0); }
+inline bool HasNonAscii(Vector data) { return ToMask(vcgeq_u8(data, vdupq_n_u8(0x80))) != 0; }
+#endif
+
+inline int CountTrailingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER)
+  unsigned long index;
+  if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+    return static_cast<int>(index);
+  _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+  return static_cast<int>(index) + 32;
+#else
+  return __builtin_ctzll(mask);
+#endif
+}
+
+inline size_t FirstMatch(uint64_t mask)
+{
+  return CountTrailingZeros(mask) / MASK_BITS_PER_BYTE;
+}
+
+inline uint64_t ClearFirstMatch(uint64_t mask)
+{
+  return mask & ~(((uint64_t{1} << MASK_BITS_PER_BYTE) - 1) << CountTrailingZeros(mask));
+}
+#endif // IPTV_SCAN_AVX2 || IPTV_SCAN_SSE2 || IPTV_SCAN_NEON
+
+bool IsOneOf(char c, const char* chars)
+{
+  return c != '\0' && std::strchr(chars, c);
+}
+
+} // unnamed namespace
+
+const char* ScanUtils::GetKernelName()
+{
+#if defined(IPTV_SCAN_AVX2)
+  return "AVX2";
+#elif defined(IPTV_SCAN_SSE2)
+  return "SSE2";
+#elif defined(IPTV_SCAN_NEON)
+  return "NEON";
+#else
+  return "scalar";
+#endif
+}
+
+const char* ScanUtils::FindChar(const char* position, const char* end, char c)
+{
+  // The C library's memchr() is already vectorised on all the platforms we build for
+  if (position >= end)
+    return nullptr;
+
+  return static_cast<const char*>(std::memchr(position, c, end - position));
+}
+
+const char* ScanUtils::FindAnyOf(const char* position, const char* end, char c1, char c2, char c3)
+{
+#if defined(IPTV_SCAN_VECTOR)
+  const Vector vector1 = Broadcast(c1);
+  const Vector vector2 = Broadcast(c2);
+  const Vector vector3 = Broadcast(c3);
+
+  while (end - position >= static_cast<std::ptrdiff_t>(VECTOR_SIZE))
+  {
+    const Vector data = Load(position);
+    const uint64_t mask = ToMask(Or(Or(Equal(data, vector1), Equal(data, vector2)), Equal(data, vector3)));
+    if (mask)
+      return position + FirstMatch(mask);
+
+    position += VECTOR_SIZE;
+  }
+#endif
+
+  for (; position < end; position++)
+  {
+    if (*position == c1 || *position == c2 || *position == c3)
+      return position;
+  }
+
+  return nullptr;
+}
+
+const char* ScanUtils::FindString(const char* position, const char* end, const char* needle, size_t needleLength)
+{
+  if (needleLength == 0)
+    return position;
+
+  if (needleLength == 1)
+    return FindChar(position, end, needle[0]);
+
+#if defined(IPTV_SCAN_VECTOR)
+  // Only candidates where both the first and the last byte of the needle match are compared,
+  // which skips the many '<' characters that are not the tag being looked for
+  const Vector first = Broadcast(needle[0]);
+  const Vector last = Broadcast(needle[needleLength - 1]);
+
+  while (end - position >= static_cast<std::ptrdiff_t>(needleLength - 1 + VECTOR_SIZE))
+  {
+    uint64_t mask = ToMask(And(Equal(Load(position), first), Equal(Load(position + needleLength - 1), last)));
+    while (mask)
+    {
+      const char* candidate = position + FirstMatch(mask);
+      if (std::memcmp(candidate + 1, needle + 1, needleLength - 2) == 0)
+        return candidate;
+
+      mask = ClearFirstMatch(mask);
+    }
+
+    position += VECTOR_SIZE;
+  }
+#endif
+
+  while (static_cast<size_t>(end - position) >= needleLength)
+  {
+    position = static_cast<const char*>(std::memchr(position, needle[0], end - position - needleLength + 1));
+    if (!position)
+      return nullptr;
+
+    if (std::memcmp(position, needle, needleLength) == 0)
+      return position;
+
+    position++;
+  }
+
+  return nullptr;
+}
+
+bool ScanUtils::GetNextLine(const char*& position, const char* end, const char*& lineStart, const char*& lineEnd)
+{
+  if (position >= end)
+    return false;
+
+  lineStart = position;
+  lineEnd = FindChar(position, end, '\n');
+  if (lineEnd)
+  {
+    position = lineEnd + 1;
+  }
+  else
+  {
+    lineEnd = end;
+    position = end;
+  }
+
+  return true;
+}
+
+const char* ScanUtils::TrimLeft(const char* start, const char* end, const char* chars)
+{
+  // Whitespace runs are only ever a few bytes so these are left as scalar loops
+  while (start < end && IsOneOf(*start, chars))
+    start++;
+
+  return start;
+}
+
+const char* ScanUtils::TrimRight(const char* start, const char* end, const char* chars)
+{
+  while (end > start && IsOneOf(end[-1], chars))
+    end--;
+
+  return end;
+}
+
+bool ScanUtils::IsValidUtf8(const char* position, const char* end)
+{
+  const unsigned char* data = reinterpret_cast<const unsigned char*>(position);
+  const unsigned char* dataEnd = reinterpret_cast<const unsigned char*>(end);
+
+  while (data < dataEnd)
+  {
+#if defined(IPTV_SCAN_VECTOR)
+    // Nearly everything is ASCII so skip over it a vector at a time
+    while (dataEnd - data >= static_cast<std::ptrdiff_t>(VECTOR_SIZE) && !HasNonAscii(Load(reinterpret_cast<const char*>(data))))
+      data += VECTOR_SIZE;
+
+    if (data == dataEnd)
+      break;
+#endif
+
+    const unsigned char c = *data;
+    if (c < 0x80)
+    {
+      data++;
+      continue;
+    }
+
+    size_t length;
+    unsigned char secondMin = 0x80;
+    unsigned char secondMax = 0xBF;
+
+    if (c >= 0xC2 && c <= 0xDF)
+    {
+      length = 2;
+    }
+    else if (c >= 0xE0 && c <= 0xEF)
+    {
+      length = 3;
+      if (c == 0xE0)
+        secondMin = 0xA0; // Overlong
+      else if (c == 0xED)
+        secondMax = 0x9F; // Surrogates
+    }
+    else if (c >= 0xF0 && c <= 0xF4)
+    {
+      length = 4;
+      if (c == 0xF0)
+        secondMin = 0x90; // Overlong
+      else if (c == 0xF4)
+        secondMax = 0x8F; // Above U+10FFFF
+    }
+    else
+    {
+      return false;
+    }
+
+    if (static_cast<size_t>(dataEnd - data) < length || data[1] < secondMin || data[1] > secondMax)
+      return false;
+
+    for (size_t i = 2; i < length; i++)
+    {
+      if ((data[i] & 0xC0) != 0x80)
+        return false;
+    }
+
+    data += length;
+  }
+
+  return true;
+}
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * Byte scanning kernels used when tokenising M3U and XMLTV data. The searches are
+     * vectorised with AVX2 or SSE2 on x86 and NEON on ARM where the compiler targets
+     * them, otherwise they fall back to plain scalar code.
+     *
+     * All functions work on the range [position, end) and return nullptr when there
+     * is no match.
+     */
+    class ScanUtils
+    {
+    public:
+      static const char* GetKernelName();
+
+      static const char* FindChar(const char* position, const char* end, char c);
+      static const char* FindAnyOf(const char* position, const char* end, char c1, char c2, char c3);
+      static const char* FindString(const char* position, const char* end, const char* needle, size_t needleLength);
+
+      // Splits on '\n' the same as std::getline(), i.e. there is no empty line after a final newline
+      static bool GetNextLine(const char*& position, const char* end, const char*& lineStart, const char*& lineEnd);
+
+      static const char* TrimLeft(const char* start, const char* end, const char* chars);
+      static const char* TrimRight(const char* start, const char* end, const char* chars);
+
+      // Strict UTF-8 validation, i.e. no overlong forms, surrogates or code points above U+10FFFF
+      static bool IsValidUtf8(const char* position, const char* end);
+    };
+  } // namespace utilities
+} // namespace iptvsimple
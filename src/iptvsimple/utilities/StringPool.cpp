@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "StringPool.h"
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+const std::string InternedString::EMPTY_STRING;
+
+InternedString StringPool::Intern(const std::string& value)
+{
+  if (value.empty())
+    return {};
+
+  m_internCount.fetch_add(1, std::memory_order_relaxed);
+
+  const std::string_view key(value);
+  Shard& shard = m_shards[std::hash<std::string_view>()(key) % SHARD_COUNT];
+
+  std::lock_guard<std::mutex> lock(shard.m_mutex);
+
+  auto it = shard.m_strings.find(key);
+  if (it != shard.m_strings.end())
+  {
+    m_hitCount.fetch_add(1, std::memory_order_relaxed);
+    m_bytesSaved.fetch_add(value.size(), std::memory_order_relaxed);
+    return InternedString(it->second);
+  }
+
+  auto sharedValue = std::make_shared<const std::string>(value);
+  shard.m_strings.emplace(std::string_view(*sharedValue), sharedValue);
+
+  return InternedString(sharedValue);
+}
+
+void StringPool::Clear()
+{
+  for (auto& shard : m_shards)
+  {
+    std::lock_guard<std::mutex> lock(shard.m_mutex);
+    shard.m_strings.clear();
+  }
+
+  m_internCount = 0;
+  m_hitCount = 0;
+  m_bytesSaved = 0;
+}
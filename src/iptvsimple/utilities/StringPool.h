@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * An immutable string which can be shared by many owners. Copying only copies the
+     * handle, and an empty string takes no storage at all. It converts to a
+     * const std::string& so it can be used wherever a std::string is read.
+     */
+    class InternedString
+    {
+    public:
+      InternedString() = default;
+      InternedString(const std::string& value)
+        : m_value(value.empty() ? nullptr : std::make_shared<const std::string>(value)) {}
+
+      InternedString& operator=(const std::string& value) { return *this = InternedString(value); }
+
+      const std::string& Get() const { return m_value ? *m_value : EMPTY_STRING; }
+      operator const std::string&() const { return Get(); }
+
+      const char* c_str() const { return Get().c_str(); }
+      size_t size() const { return m_value ? m_value->size() : 0; }
+      bool empty() const { return !m_value; }
+      void clear() { m_value.reset(); }
+
+      // Strings from the same pool compare by handle
+      bool operator==(const InternedString& other) const { return m_value == other.m_value || Get() == other.Get(); }
+      bool operator!=(const InternedString& other) const { return !(*this == other); }
+
+    private:
+      friend class StringPool;
+
+      InternedString(const std::shared_ptr<const std::string>& value) : m_value(value) {}
+
+      static const std::string EMPTY_STRING;
+
+      std::shared_ptr<const std::string> m_value;
+    };
+
+    /*
+     * Keeps a single copy of each distinct string so the text repeated across EPG entries,
+     * e.g. titles, genres, credits and ratings, is only stored once. Strings stay valid for
+     * as long as any InternedString refers to them, clearing the pool only stops it from
+     * handing them out again. Intern() can be called from any number of threads.
+     */
+    class StringPool
+    {
+    public:
+      InternedString Intern(const std::string& value);
+      void Clear();
+
+      size_t GetInternCount() const { return m_internCount; }
+      size_t GetHitCount() const { return m_hitCount; }
+      size_t GetBytesSaved() const { return m_bytesSaved; }
+
+    private:
+      // Sharded by hash so parallel loading threads rarely wait on each other
+      static const size_t SHARD_COUNT = 16;
+
+      struct Shard
+      {
+        std::mutex m_mutex;
+        // The key views the data of the shared string it maps to
+        std::unordered_map<std::string_view, std::shared_ptr<const std::string>> m_strings;
+      };
+
+      Shard m_shards[SHARD_COUNT];
+
+      std::atomic<size_t> m_internCount{0};
+      std::atomic<size_t> m_hitCount{0};
+      std::atomic<size_t> m_bytesSaved{0};
+    };
+  } // namespace utilities
+} // namespace iptvsimple
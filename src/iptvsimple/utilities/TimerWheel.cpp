@@ -0,0 +1,69 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "TimerWheel.h"
+
+#include <algorithm>
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+TimerWheel::TimerWheel(time_t slotSeconds, size_t slotCount)
+  : m_slotSeconds(std::max(slotSeconds, static_cast<time_t>(1))), m_slots(std::max(slotCount, static_cast<size_t>(1)))
+{
+}
+
+void TimerWheel::Schedule(int key, time_t time)
+{
+  // Nothing is ever put in a slot already passed, it would not be looked at for a whole lap
+  const time_t tick = std::max(time / m_slotSeconds, m_lastTick);
+  GetSlot(tick).push_back({key, time});
+  m_timerCount++;
+}
+
+void TimerWheel::Advance(time_t time, const std::function<void(int key)>& expired)
+{
+  const time_t tick = time / m_slotSeconds;
+  if (m_timerCount == 0 || tick < m_lastTick)
+  {
+    m_lastTick = std::max(m_lastTick, tick);
+    return;
+  }
+
+  // The slot of the last tick is looked at again as it may have timers later in the slot. After
+  // a long gap each slot only needs to be looked at once.
+  const time_t firstTick = std::max(m_lastTick, tick - static_cast<time_t>(m_slots.size()) + 1);
+  m_lastTick = tick;
+
+  std::vector<Timer> timers;
+  for (time_t slotTick = firstTick; slotTick <= tick; slotTick++)
+  {
+    // Taken out of the slot so the callback can schedule into it
+    timers.clear();
+    timers.swap(GetSlot(slotTick));
+
+    for (const auto& timer : timers)
+    {
+      if (timer.m_time <= time)
+      {
+        m_timerCount--;
+        expired(timer.m_key);
+      }
+      else
+      {
+        GetSlot(slotTick).push_back(timer);
+      }
+    }
+  }
+}
+
+void TimerWheel::Clear()
+{
+  for (auto& slot : m_slots)
+    slot.clear();
+  m_timerCount = 0;
+}
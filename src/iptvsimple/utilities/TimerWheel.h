@@ -0,0 +1,51 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <ctime>
+#include <functional>
+#include <vector>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * Timers for keys hashed into a ring of slots by the time they expire, so scheduling
+     * one is O(1) and advancing only looks at the slots passed since the last advance.
+     * Timers further away than the whole ring go round it until their lap comes up.
+     */
+    class TimerWheel
+    {
+    public:
+      TimerWheel(time_t slotSeconds, size_t slotCount);
+
+      // A time already passed expires on the next advance, or the current one if called from it
+      void Schedule(int key, time_t time);
+      // Calls expired for every timer due by the time, it may schedule new timers
+      void Advance(time_t time, const std::function<void(int key)>& expired);
+      void Clear();
+
+      size_t GetTimerCount() const { return m_timerCount; }
+
+    private:
+      struct Timer
+      {
+        int m_key;
+        time_t m_time;
+      };
+
+      std::vector<Timer>& GetSlot(time_t tick) { return m_slots[static_cast<size_t>(tick) % m_slots.size()]; }
+
+      const time_t m_slotSeconds;
+      std::vector<std::vector<Timer>> m_slots;
+      time_t m_lastTick = 0;
+      size_t m_timerCount = 0;
+    };
+  } // namespace utilities
+} // namespace iptvsimple
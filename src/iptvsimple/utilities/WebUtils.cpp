@@ -69,15 +69,26 @@ bool WebUtils::IsHttpUrl(const std::string& url)
 
 std::string WebUtils::RedactUrl(const std::string& url)
 {
-  std::string redactedUrl = url;
-  static const std::regex regex("^(http:|https:)//[^@/]+:[^@/]+@.*$");
-  if (std::regex_match(url, regex))
-  {
-    std::string protocol = url.substr(0, url.find_first_of(":"));
-    std::string fullPrefix = url.substr(url.find_first_of("@") + 1);
+  // Equivalent to matching "^(http:|https:)//[^@/]+:[^@/]+@.*$" but cheap enough to run on every zap
+  size_t credentialsStart;
+  if (StringUtils::StartsWith(url, HTTP_PREFIX))
+    credentialsStart = HTTP_PREFIX.size();
+  else if (StringUtils::StartsWith(url, HTTPS_PREFIX))
+    credentialsStart = HTTPS_PREFIX.size();
+  else
+    return url;
 
-    redactedUrl = protocol + "://USERNAME:PASSWORD@" + fullPrefix;
-  }
+  const size_t credentialsEnd = url.find_first_of("@/", credentialsStart);
+  if (credentialsEnd == std::string::npos || url[credentialsEnd] != '@' ||
+      url.find_first_of("\r\n", credentialsEnd) != std::string::npos)
+    return url;
+
+  const size_t separator = url.find(':', credentialsStart + 1);
+  if (separator >= credentialsEnd - 1)
+    return url;
+
+  const std::string protocol = url.substr(0, url.find_first_of(":"));
+  const std::string fullPrefix = url.substr(credentialsEnd + 1);
 
-  return redactedUrl;
+  return protocol + "://USERNAME:PASSWORD@" + fullPrefix;
 }
@@ -0,0 +1,78 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "WorkerPool.h"
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+  if (threadCount == 0)
+    threadCount = 1;
+
+  for (size_t i = 0; i < threadCount; i++)
+    m_threads.emplace_back([this] { Run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_taskAvailable.notify_all();
+
+  for (auto& thread : m_threads)
+  {
+    if (thread.joinable())
+      thread.join();
+  }
+}
+
+std::future<void> WorkerPool::Submit(const std::function<void()>& task)
+{
+  std::packaged_task<void()> packagedTask(task);
+  std::future<void> future = packagedTask.get_future();
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.emplace_back(std::move(packagedTask));
+  }
+  m_taskAvailable.notify_one();
+
+  return future;
+}
+
+size_t WorkerPool::GetDefaultThreadCount()
+{
+  // hardware_concurrency() is allowed to return 0 when it can't be determined
+  const unsigned int cores = std::thread::hardware_concurrency();
+
+  return cores > 0 ? cores : 1;
+}
+
+void WorkerPool::Run()
+{
+  while (true)
+  {
+    std::packaged_task<void()> task;
+
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_taskAvailable.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+      if (m_tasks.empty())
+        return;
+
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+
+    task();
+  }
+}
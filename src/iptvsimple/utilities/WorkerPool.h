@@ -0,0 +1,49 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * A fixed set of threads running tasks in the order they are submitted. The
+     * returned future can be used to wait for a given task. Any tasks still queued
+     * when the pool is destroyed are run before the threads exit.
+     */
+    class WorkerPool
+    {
+    public:
+      WorkerPool(size_t threadCount);
+      ~WorkerPool();
+
+      std::future<void> Submit(const std::function<void()>& task);
+      size_t GetThreadCount() const { return m_threads.size(); }
+
+      static size_t GetDefaultThreadCount();
+
+    private:
+      void Run();
+
+      std::vector<std::thread> m_threads;
+      std::deque<std::packaged_task<void()>> m_tasks;
+      bool m_stopping = false;
+
+      std::mutex m_mutex;
+      std::condition_variable m_taskAvailable;
+    };
+  } // namespace utilities
+} // namespace iptvsimple
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -63,25 +64,29 @@ inline bool GetAttributeValue(const pugi::xml_node& node, const char* attributeN
 
 inline int GetParseErrorString(const char* buffer, int errorOffset, std::string& errorString)
 {
-  errorString = buffer;
+  // Work on the buffer directly, it can be a very large document and only a few lines are needed
 
   // Try and start the error string two newlines before the error offset
   int startOffset = errorOffset;
-  size_t found = errorString.rfind("\n", errorOffset);
-  if (found != std::string::npos)
+  int found = errorOffset;
+  while (found >= 0 && buffer[found] != '\n')
+    found--;
+  if (found >= 0)
   {
     startOffset = found;
-    found = errorString.rfind("\n", startOffset - 1);
-    if (found != std::string::npos && startOffset != 0)
+    found = startOffset - 1;
+    while (found >= 0 && buffer[found] != '\n')
+      found--;
+    if (found >= 0 && startOffset != 0)
       startOffset = found;
   }
 
-  // And end itone newline after
+  // And end it one newline after
   int endOffset = errorOffset;
-  found = errorString.find("\n", errorOffset);
-  if (found != std::string::npos)
-    endOffset = found;
+  const char* newline = std::strchr(buffer + errorOffset, '\n');
+  if (newline)
+    endOffset = static_cast<int>(newline - buffer);
 
-  errorString = errorString.substr(startOffset, endOffset - startOffset);
+  errorString.assign(buffer + startOffset, endOffset - startOffset);
   return errorOffset - startOffset;
 }
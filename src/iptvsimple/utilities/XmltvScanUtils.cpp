@@ -0,0 +1,169 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "XmltvScanUtils.h"
+
+#include <limits>
+
+using namespace iptvsimple;
+using namespace iptvsimple::utilities;
+
+namespace
+{
+
+constexpr size_t XMLTV_DATE_LENGTH = 8;
+
+bool IsScanSpace(char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+bool IsOnScreenIgnoredChar(char c)
+{
+  return c == ' ' || c == '\t' || c == 'x' || c == 'X' || c == '_' || c == '.';
+}
+
+// Reads the next character of an onscreen episode number skipping the ones that are ignored
+char PeekOnScreenChar(const char*& position)
+{
+  while (IsOnScreenIgnoredChar(*position))
+    position++;
+
+  return *position;
+}
+
+// One or more digits, as atoi() but failing rather than overflowing for numbers too big for an int
+bool ScanOnScreenNumber(const char*& position, int& value)
+{
+  long long number = 0;
+  bool found = false;
+  bool overflowed = false;
+  char c;
+  while ((c = PeekOnScreenChar(position)) >= '0' && c <= '9')
+  {
+    if (!overflowed)
+    {
+      number = number * 10 + (c - '0');
+      overflowed = number > std::numeric_limits<int>::max();
+    }
+    found = true;
+    position++;
+  }
+
+  if (!found || overflowed)
+    return false;
+
+  value = static_cast<int>(number);
+  return true;
+}
+
+} // unnamed namespace
+
+bool XmltvScanUtils::ScanInt(const char*& position, int width, int& value)
+{
+  const char* p = position;
+  while (IsScanSpace(*p))
+    p++;
+
+  int remaining = width > 0 ? width : std::numeric_limits<int>::max();
+  bool negative = false;
+  if (*p == '-' || *p == '+')
+  {
+    negative = *p == '-';
+    p++;
+    remaining--;
+  }
+
+  // Unsigned so a number too big for an int wraps round rather than overflowing
+  unsigned int number = 0;
+  const char* digitsStart = p;
+  while (remaining > 0 && *p >= '0' && *p <= '9')
+  {
+    number = number * 10 + (*p - '0');
+    p++;
+    remaining--;
+  }
+
+  if (p == digitsStart)
+    return false;
+
+  value = static_cast<int>(negative ? 0u - number : number);
+  position = p;
+  return true;
+}
+
+bool XmltvScanUtils::ScanChar(const char*& position, char& value)
+{
+  while (IsScanSpace(*position))
+    position++;
+
+  if (*position == '\0')
+    return false;
+
+  value = *position++;
+  return true;
+}
+
+bool XmltvScanUtils::ScanDate(const char*& position, int& year, int& mon, int& mday)
+{
+  return ScanInt(position, 4, year) && ScanInt(position, 2, mon) && ScanInt(position, 2, mday);
+}
+
+void XmltvScanUtils::ScanTime(const char*& position, int& hour, int& min, int& sec, char& offsetSign, int& offsetHours, int& offsetMinutes)
+{
+  ScanInt(position, 2, hour) && ScanInt(position, 2, min) && ScanInt(position, 2, sec) &&
+  ScanChar(position, offsetSign) && ScanInt(position, 2, offsetHours) && ScanInt(position, 2, offsetMinutes);
+}
+
+bool XmltvScanUtils::IsXmltvDate(const std::string& dateString)
+{
+  if (dateString.size() != XMLTV_DATE_LENGTH || dateString[0] < '1' || dateString[0] > '9')
+    return false;
+
+  for (size_t i = 1; i < XMLTV_DATE_LENGTH; i++)
+  {
+    if (dateString[i] < '0' || dateString[i] > '9')
+      return false;
+  }
+
+  return true;
+}
+
+bool XmltvScanUtils::ParseOnScreenEpisodeNumber(const std::string& episodeNumberString, int& seasonNumber, int& episodeNumber)
+{
+  const char* position = episodeNumberString.c_str();
+  int season;
+  int episode;
+
+  char c = PeekOnScreenChar(position);
+  const bool hasSeason = c == 's' || c == 'S';
+  if (hasSeason)
+  {
+    position++;
+    if (!ScanOnScreenNumber(position, season))
+      return false;
+
+    c = PeekOnScreenChar(position);
+  }
+
+  if (c != 'e' && c != 'E')
+    return false;
+  position++;
+
+  c = PeekOnScreenChar(position);
+  if (c == 'p' || c == 'P')
+    position++;
+
+  if (!ScanOnScreenNumber(position, episode) || PeekOnScreenChar(position) != '\0')
+    return false;
+
+  if (hasSeason)
+    seasonNumber = season;
+  episodeNumber = episode;
+
+  return true;
+}
@@ -0,0 +1,43 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#pragma once
+
+#include <string>
+
+namespace iptvsimple
+{
+  namespace utilities
+  {
+    /*
+     * Scanners for the numbers in XMLTV timestamps and episode numbers. They read the
+     * same as the sscanf() conversions and regular expressions they replaced, without
+     * their overhead, and move the position past what they read on success.
+     */
+    class XmltvScanUtils
+    {
+    public:
+      // As sscanf() "%<width>d", a width of 0 means no limit. Digits beyond what fits in an
+      // int are still read but the value wraps round as it does with glibc's sscanf().
+      static bool ScanInt(const char*& position, int width, int& value);
+      // As sscanf() " %c"
+      static bool ScanChar(const char*& position, char& value);
+      // As sscanf() with "%04d%02d%02d", fields which can't be read keep their existing values
+      static bool ScanDate(const char*& position, int& year, int& mon, int& mday);
+      // As sscanf() with "%02d%02d%02d %c%02d%02d", fields which can't be read keep their existing values
+      static void ScanTime(const char*& position, int& hour, int& min, int& sec, char& offsetSign, int& offsetHours, int& offsetMinutes);
+
+      // Exactly 8 digits, not starting with 0
+      static bool IsXmltvDate(const std::string& dateString);
+
+      // Matches "S<season>E<episode>" or "E<episode>" with an optional 'P' after the 'E' in any
+      // case, ignoring any spaces, tabs, 'x', '_' and '.' characters. The season number is only
+      // set if there is one. A number too big for an int does not match.
+      static bool ParseOnScreenEpisodeNumber(const std::string& episodeNumberString, int& seasonNumber, int& episodeNumber);
+    };
+  } // namespace utilities
+} // namespace iptvsimple
@@ -0,0 +1,189 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "../iptvsimple/ChannelEpgIndex.h"
+
+#include <cctype>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace iptvsimple;
+
+namespace
+{
+
+const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+struct TestChannelEpg
+{
+  std::string m_id;
+  std::vector<std::pair<std::string, std::string>> m_displayNames; // With and without underscores
+};
+
+bool EqualsNoCase(const std::string& left, const std::string& right)
+{
+  if (left.size() != right.size())
+    return false;
+
+  for (size_t i = 0; i < left.size(); i++)
+  {
+    if (std::tolower(static_cast<unsigned char>(left[i])) != std::tolower(static_cast<unsigned char>(right[i])))
+      return false;
+  }
+
+  return true;
+}
+
+// The searches through the channel EPGs the index replaced
+size_t FindByNamesReference(const std::vector<TestChannelEpg>& channelEpgs, const std::string& tvgId,
+                            const std::string& tvgName, const std::string& displayName)
+{
+  for (size_t i = 0; i < channelEpgs.size(); i++)
+  {
+    if (EqualsNoCase(channelEpgs[i].m_id, tvgId))
+      return i;
+  }
+
+  for (size_t i = 0; i < channelEpgs.size(); i++)
+  {
+    for (const auto& names : channelEpgs[i].m_displayNames)
+    {
+      if (EqualsNoCase(names.second, tvgName) || EqualsNoCase(names.first, tvgName))
+        return i;
+    }
+  }
+
+  for (size_t i = 0; i < channelEpgs.size(); i++)
+  {
+    for (const auto& names : channelEpgs[i].m_displayNames)
+    {
+      if (EqualsNoCase(names.first, displayName))
+        return i;
+    }
+  }
+
+  return NOT_FOUND;
+}
+
+ChannelEpgIndex MakeIndex(const std::vector<TestChannelEpg>& channelEpgs)
+{
+  ChannelEpgIndex index;
+  for (size_t i = 0; i < channelEpgs.size(); i++)
+    index.AddId(channelEpgs[i].m_id, i);
+
+  for (size_t i = 0; i < channelEpgs.size(); i++)
+  {
+    for (const auto& names : channelEpgs[i].m_displayNames)
+      index.AddDisplayName(names.first, names.second, i);
+  }
+
+  return index;
+}
+
+size_t FindByNames(const ChannelEpgIndex& index, const std::string& tvgId, const std::string& tvgName, const std::string& displayName)
+{
+  size_t channelEpgIndex = NOT_FOUND;
+  return index.FindByNames(tvgId, tvgName, displayName, channelEpgIndex) ? channelEpgIndex : NOT_FOUND;
+}
+
+} // unnamed namespace
+
+TEST(ChannelEpgIndexTest, FindsByIdThenTvgNameThenDisplayName)
+{
+  const std::vector<TestChannelEpg> channelEpgs = {
+    {"bbc1.uk", {{"BBC One", "BBC_One"}}},
+    {"bbc2.uk", {{"BBC Two", "BBC_Two"}, {"BBC One", "BBC_One"}}},
+    {"itv.uk", {{"ITV", "ITV"}, {"bbc1.uk", "bbc1.uk"}}},
+  };
+  const ChannelEpgIndex index = MakeIndex(channelEpgs);
+
+  // The id wins over a display name which is the same
+  EXPECT_EQ(FindByNames(index, "BBC1.UK", "", ""), 0u);
+  EXPECT_EQ(FindByNames(index, "itv.uk", "BBC One", "BBC Two"), 2u);
+  // tvg-name with or without underscores, the first channel EPG with the name is found
+  EXPECT_EQ(FindByNames(index, "missing", "bbc_two", "ITV"), 1u);
+  EXPECT_EQ(FindByNames(index, "", "BBC One", ""), 0u);
+  // The channel name only matches display names as they are
+  EXPECT_EQ(FindByNames(index, "", "", "itv"), 2u);
+  EXPECT_EQ(FindByNames(index, "", "", "BBC_Two"), NOT_FOUND);
+  EXPECT_EQ(FindByNames(index, "", "", ""), NOT_FOUND);
+}
+
+TEST(ChannelEpgIndexTest, FindByIdKeepsFirstChannelEpgForId)
+{
+  ChannelEpgIndex index;
+  index.AddId("Channel.One", 3);
+  index.AddId("channel.one", 5);
+
+  size_t channelEpgIndex = NOT_FOUND;
+  EXPECT_TRUE(index.FindById("CHANNEL.ONE", channelEpgIndex));
+  EXPECT_EQ(channelEpgIndex, 3u);
+  EXPECT_FALSE(index.FindById("channel.two", channelEpgIndex));
+}
+
+TEST(ChannelEpgIndexTest, ClearDisplayNamesKeepsIds)
+{
+  ChannelEpgIndex index = MakeIndex({{"one", {{"One", "One"}}}});
+  index.ClearDisplayNames();
+
+  EXPECT_EQ(index.GetDisplayNameCount(), 0u);
+  EXPECT_EQ(FindByNames(index, "one", "", ""), 0u);
+  EXPECT_EQ(FindByNames(index, "", "One", "One"), NOT_FOUND);
+
+  index.Clear();
+  EXPECT_EQ(FindByNames(index, "one", "", ""), NOT_FOUND);
+}
+
+TEST(ChannelEpgIndexTest, FindsTheSameChannelEpgsAsSearching)
+{
+  // A small pool of names in mixed case so ids and display names collide often
+  const std::vector<std::string> names = {"One", "one", "ONE", "Two", "two", "Three", "Four", "four", "One_HD", "One HD", "", "x"};
+  std::mt19937 random(12345);
+  auto randomName = [&]() { return names[random() % names.size()]; };
+
+  for (int round = 0; round < 200; round++)
+  {
+    std::vector<TestChannelEpg> channelEpgs;
+    const size_t channelEpgCount = random() % 8;
+    for (size_t i = 0; i < channelEpgCount; i++)
+    {
+      // Ids are unique without case as channel EPGs with the same id are combined when loaded
+      std::string id = randomName() + std::to_string(random() % 3);
+      bool duplicate = false;
+      for (const TestChannelEpg& channelEpg : channelEpgs)
+        duplicate = duplicate || EqualsNoCase(channelEpg.m_id, id);
+      if (duplicate)
+        continue;
+
+      TestChannelEpg channelEpg{id, {}};
+      const size_t displayNameCount = random() % 3;
+      for (size_t j = 0; j < displayNameCount; j++)
+      {
+        std::string displayName = randomName();
+        std::string displayNameWithUnderscores = displayName;
+        for (char& c : displayNameWithUnderscores)
+          c = c == ' ' ? '_' : c;
+        channelEpg.m_displayNames.emplace_back(displayName, displayNameWithUnderscores);
+      }
+      channelEpgs.emplace_back(channelEpg);
+    }
+
+    const ChannelEpgIndex index = MakeIndex(channelEpgs);
+    for (int lookup = 0; lookup < 50; lookup++)
+    {
+      const std::string tvgId = randomName() + std::to_string(random() % 3);
+      const std::string tvgName = randomName();
+      const std::string displayName = randomName();
+
+      EXPECT_EQ(FindByNames(index, tvgId, tvgName, displayName), FindByNamesReference(channelEpgs, tvgId, tvgName, displayName))
+          << "tvg-id '" << tvgId << "' tvg-name '" << tvgName << "' name '" << displayName << "'";
+    }
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "../iptvsimple/EpgLoadWindow.h"
+
+#include <gtest/gtest.h>
+
+using namespace iptvsimple;
+
+namespace
+{
+
+const time_t HOUR = 60 * 60;
+const time_t DAY = 24 * HOUR;
+const time_t NOW = 1615800000;
+
+} // unnamed namespace
+
+TEST(EpgLoadWindowTest, EmptyWindowCoversNothing)
+{
+  EpgLoadWindow window;
+
+  EXPECT_TRUE(window.IsEmpty());
+  EXPECT_FALSE(window.Covers(NOW, NOW + 1));
+  EXPECT_FALSE(window.CoversStart(NOW));
+  EXPECT_FALSE(window.CoversEndWithSlack(NOW));
+}
+
+TEST(EpgLoadWindowTest, CoversWindowsInsideIt)
+{
+  EpgLoadWindow window;
+  window.Set(NOW - 3 * DAY, NOW + 3 * DAY);
+
+  EXPECT_TRUE(window.Covers(NOW - 3 * DAY, NOW + 3 * DAY));
+  EXPECT_TRUE(window.Covers(NOW, NOW + DAY));
+  EXPECT_FALSE(window.Covers(NOW - 4 * DAY, NOW));
+  EXPECT_FALSE(window.Covers(NOW, NOW + 4 * DAY));
+
+  // A window moved on a little in time is still covered by the slack, one moved on further is not
+  EXPECT_TRUE(window.CoversStart(NOW));
+  EXPECT_TRUE(window.CoversEndWithSlack(NOW + 3 * DAY + HOUR));
+  EXPECT_FALSE(window.CoversEndWithSlack(NOW + 4 * DAY));
+}
+
+TEST(EpgLoadWindowTest, WindowExtendedThenPrunedStillCoversOldStart)
+{
+  // Kodi keeps asking for the window its guide started with while the end moves on with the time
+  const time_t guideStart = NOW - 3 * DAY;
+  EpgLoadWindow window;
+  window.Set(guideStart, NOW + 3 * DAY);
+
+  // A day later the window is extended with the programmes kept from the load, then pruned
+  const time_t later = NOW + DAY;
+  window.ExtendTo(later + 3 * DAY);
+  window.PruneTo(later + 3 * DAY);
+
+  // The next request with the old start needs no load
+  EXPECT_EQ(window.GetStart(), guideStart);
+  EXPECT_TRUE(window.Covers(guideStart, later + 3 * DAY));
+  EXPECT_TRUE(window.Covers(later - 3 * DAY, later + 3 * DAY));
+}
+
+TEST(EpgLoadWindowTest, PruneOnlyNarrowsTheEnd)
+{
+  EpgLoadWindow window;
+  window.Set(NOW - 3 * DAY, NOW + 7 * DAY);
+
+  // e.g. fewer future days set
+  window.PruneTo(NOW + 2 * DAY);
+  EXPECT_EQ(window.GetStart(), NOW - 3 * DAY);
+  EXPECT_EQ(window.GetEnd(), NOW + 2 * DAY);
+  EXPECT_FALSE(window.Covers(NOW, NOW + 3 * DAY));
+
+  // Pruning to a later end does not widen it, nor to before the start turn it inside out
+  window.PruneTo(NOW + 5 * DAY);
+  EXPECT_EQ(window.GetEnd(), NOW + 2 * DAY);
+  window.PruneTo(NOW - 5 * DAY);
+  EXPECT_TRUE(window.IsEmpty());
+}
+
+TEST(EpgLoadWindowTest, WidenCoversBothWindows)
+{
+  EpgLoadWindow window;
+  time_t start = NOW;
+  time_t end = NOW + DAY;
+
+  window.Widen(start, end);
+  EXPECT_EQ(start, NOW);
+  EXPECT_EQ(end, NOW + DAY);
+
+  window.Set(NOW - DAY, NOW + HOUR);
+  window.Widen(start, end);
+  EXPECT_EQ(start, NOW - DAY);
+  EXPECT_EQ(end, NOW + DAY);
+
+  window.Clear();
+  EXPECT_TRUE(window.IsEmpty());
+}
@@ -0,0 +1,283 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "../iptvsimple/utilities/ScanUtils.h"
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace iptvsimple::utilities;
+
+namespace
+{
+
+// Covers an empty range, ranges shorter than a vector and several vectors with every tail length
+const size_t MAX_TEST_LENGTH = 3 * 32 + 5;
+
+// The data is copied to the end of a buffer of exactly its size so a kernel reading past
+// the end of the range reads past the end of the allocation
+class ExactBuffer
+{
+public:
+  explicit ExactBuffer(const std::string& data) : m_data(new char[data.size()]), m_length(data.size())
+  {
+    if (m_length > 0)
+      std::memcpy(m_data.get(), data.data(), m_length);
+  }
+
+  const char* Begin() const { return m_data.get(); }
+  const char* End() const { return m_data.get() + m_length; }
+
+  // Offset of a result from the start, or -1 for nullptr
+  long Offset(const char* result) const { return result ? result - Begin() : -1; }
+
+private:
+  std::unique_ptr<char[]> m_data;
+  size_t m_length;
+};
+
+long FindAnyOfReference(const std::string& data, char c1, char c2, char c3)
+{
+  for (size_t i = 0; i < data.size(); i++)
+  {
+    if (data[i] == c1 || data[i] == c2 || data[i] == c3)
+      return static_cast<long>(i);
+  }
+  return -1;
+}
+
+long FindStringReference(const std::string& data, const std::string& needle)
+{
+  const size_t found = data.find(needle);
+  return found == std::string::npos ? -1 : static_cast<long>(found);
+}
+
+// Decodes each sequence and checks the code point rather than the byte ranges the kernel uses
+bool IsValidUtf8Reference(const std::string& data)
+{
+  for (size_t i = 0; i < data.size();)
+  {
+    const unsigned char c = static_cast<unsigned char>(data[i]);
+    size_t length;
+    unsigned long codePoint;
+    unsigned long minCodePoint;
+
+    if (c < 0x80)
+    {
+      i++;
+      continue;
+    }
+    else if ((c & 0xE0) == 0xC0)
+    {
+      length = 2;
+      codePoint = c & 0x1F;
+      minCodePoint = 0x80;
+    }
+    else if ((c & 0xF0) == 0xE0)
+    {
+      length = 3;
+      codePoint = c & 0x0F;
+      minCodePoint = 0x800;
+    }
+    else if ((c & 0xF8) == 0xF0)
+    {
+      length = 4;
+      codePoint = c & 0x07;
+      minCodePoint = 0x10000;
+    }
+    else
+    {
+      return false;
+    }
+
+    if (i + length > data.size())
+      return false;
+
+    for (size_t j = 1; j < length; j++)
+    {
+      const unsigned char continuation = static_cast<unsigned char>(data[i + j]);
+      if ((continuation & 0xC0) != 0x80)
+        return false;
+      codePoint = (codePoint << 6) | (continuation & 0x3F);
+    }
+
+    if (codePoint < minCodePoint || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+      return false;
+
+    i += length;
+  }
+
+  return true;
+}
+
+} // unnamed namespace
+
+TEST(ScanUtilsTest, FindAnyOfMatchesReferenceAtEveryPosition)
+{
+  for (size_t length = 0; length <= MAX_TEST_LENGTH; length++)
+  {
+    // No match at all, then the match at each position including the last byte
+    for (size_t matchPosition = 0; matchPosition <= length; matchPosition++)
+    {
+      for (char match : {'<', '&', '\n'})
+      {
+        std::string data(length, 'a');
+        if (matchPosition < length)
+          data[matchPosition] = match;
+
+        const ExactBuffer buffer(data);
+        EXPECT_EQ(buffer.Offset(ScanUtils::FindAnyOf(buffer.Begin(), buffer.End(), '<', '&', '\n')),
+                  FindAnyOfReference(data, '<', '&', '\n'))
+            << ScanUtils::GetKernelName() << " length " << length << " match at " << matchPosition;
+      }
+    }
+  }
+}
+
+TEST(ScanUtilsTest, FindCharMatchesReferenceAtEveryPosition)
+{
+  for (size_t length = 0; length <= MAX_TEST_LENGTH; length++)
+  {
+    for (size_t matchPosition = 0; matchPosition <= length; matchPosition++)
+    {
+      std::string data(length, 'a');
+      if (matchPosition < length)
+        data[matchPosition] = '\n';
+
+      const ExactBuffer buffer(data);
+      EXPECT_EQ(buffer.Offset(ScanUtils::FindChar(buffer.Begin(), buffer.End(), '\n')), FindAnyOfReference(data, '\n', '\n', '\n'))
+          << "length " << length << " match at " << matchPosition;
+    }
+  }
+}
+
+TEST(ScanUtilsTest, FindStringMatchesReferenceAtEveryPosition)
+{
+  const std::vector<std::string> needles = {"<", "]]>", "-->", "</programme", "<![CDATA[", "ab"};
+
+  for (const std::string& needle : needles)
+  {
+    for (size_t length = 0; length <= MAX_TEST_LENGTH; length++)
+    {
+      for (size_t matchPosition = 0; matchPosition <= length; matchPosition++)
+      {
+        // A near miss before the real match, where only the first and last bytes of the needle
+        // match, checks the candidates are compared and not just taken
+        std::string data(length, 'a');
+        if (needle.size() > 2 && matchPosition >= needle.size())
+        {
+          data[matchPosition - needle.size()] = needle.front();
+          data[matchPosition - 1] = needle.back();
+        }
+        if (matchPosition + needle.size() <= length)
+          data.replace(matchPosition, needle.size(), needle);
+
+        const ExactBuffer buffer(data);
+        EXPECT_EQ(buffer.Offset(ScanUtils::FindString(buffer.Begin(), buffer.End(), needle.c_str(), needle.size())),
+                  FindStringReference(data, needle))
+            << ScanUtils::GetKernelName() << " needle '" << needle << "' length " << length << " match at " << matchPosition;
+      }
+    }
+  }
+}
+
+TEST(ScanUtilsTest, FindStringWithEmptyNeedleFindsStart)
+{
+  const ExactBuffer buffer("abc");
+  EXPECT_EQ(ScanUtils::FindString(buffer.Begin(), buffer.End(), "", 0), buffer.Begin());
+}
+
+TEST(ScanUtilsTest, GetNextLineSplitsLikeGetline)
+{
+  const std::vector<std::string> inputs = {"", "\n", "a", "a\n", "a\nb", "a\n\nb\n", "\n\n", std::string(40, 'x') + "\n" + std::string(70, 'y')};
+
+  for (const std::string& input : inputs)
+  {
+    std::vector<std::string> expected;
+    std::istringstream stream(input);
+    std::string line;
+    while (std::getline(stream, line))
+      expected.emplace_back(line);
+
+    std::vector<std::string> lines;
+    const ExactBuffer buffer(input);
+    const char* position = buffer.Begin();
+    const char* lineStart;
+    const char* lineEnd;
+    while (ScanUtils::GetNextLine(position, buffer.End(), lineStart, lineEnd))
+      lines.emplace_back(lineStart, lineEnd);
+
+    EXPECT_EQ(lines, expected) << "'" << input << "'";
+  }
+}
+
+TEST(ScanUtilsTest, TrimMatchesReference)
+{
+  const std::vector<std::string> inputs = {"", " ", " \t\r\n", "a", " a ", "\ta b\r\n", "ab  "};
+
+  for (const std::string& input : inputs)
+  {
+    const size_t first = input.find_first_not_of(" \t\r\n");
+    const size_t last = input.find_last_not_of(" \t\r\n");
+    const ExactBuffer buffer(input);
+
+    EXPECT_EQ(buffer.Offset(ScanUtils::TrimLeft(buffer.Begin(), buffer.End(), " \t\r\n")),
+              static_cast<long>(first == std::string::npos ? input.size() : first)) << "'" << input << "'";
+    EXPECT_EQ(buffer.Offset(ScanUtils::TrimRight(buffer.Begin(), buffer.End(), " \t\r\n")),
+              static_cast<long>(last == std::string::npos ? 0 : last + 1)) << "'" << input << "'";
+  }
+}
+
+TEST(ScanUtilsTest, IsValidUtf8MatchesReferenceAcrossVectorBoundaries)
+{
+  // Multi-byte sequences, valid and not, placed after every length of ASCII so they straddle
+  // the vector boundaries and end up in the scalar tail
+  const std::vector<std::string> sequences = {
+    "\xC3\xA9", "\xE2\x82\xAC", "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF",
+    "\xC0\xAF", "\xC1\xBF", "\xE0\x80\xAF", "\xED\xA0\x80", "\xF0\x80\x80\xAF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80",
+    "\x80", "\xBF", "\xC3", "\xE2\x82", "\xF0\x9F\x98", "\xFF", "\xC3\x28",
+  };
+
+  for (const std::string& sequence : sequences)
+  {
+    for (size_t prefixLength = 0; prefixLength <= MAX_TEST_LENGTH; prefixLength++)
+    {
+      for (size_t suffixLength : {0, 1, 31})
+      {
+        const std::string data = std::string(prefixLength, 'a') + sequence + std::string(suffixLength, 'b');
+        const ExactBuffer buffer(data);
+        EXPECT_EQ(ScanUtils::IsValidUtf8(buffer.Begin(), buffer.End()), IsValidUtf8Reference(data))
+            << ScanUtils::GetKernelName() << " prefix " << prefixLength << " suffix " << suffixLength;
+      }
+    }
+  }
+}
+
+TEST(ScanUtilsTest, IsValidUtf8MatchesReferenceForRandomData)
+{
+  const std::string bytes = std::string("a<\n") + "\x80\x8F\x90\x9F\xA0\xBF\xC0\xC2\xDF\xE0\xED\xEF\xF0\xF4\xF5\xFF";
+  std::mt19937 random(12345);
+
+  for (int i = 0; i < 20000; i++)
+  {
+    std::string data(random() % (MAX_TEST_LENGTH + 1), 'a');
+    for (char& c : data)
+    {
+      if (random() % 4 == 0)
+        c = bytes[random() % bytes.size()];
+    }
+
+    const ExactBuffer buffer(data);
+    EXPECT_EQ(ScanUtils::IsValidUtf8(buffer.Begin(), buffer.End()), IsValidUtf8Reference(data)) << ScanUtils::GetKernelName();
+  }
+}
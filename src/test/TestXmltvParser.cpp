@@ -0,0 +1,182 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "../iptvsimple/XmltvParser.h"
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace iptvsimple;
+
+namespace
+{
+
+const std::string XMLTV_DATA =
+  "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+  "<!DOCTYPE tv SYSTEM \"xmltv.dtd\" [<!ENTITY test \"<programme channel='doctype'>\">]>\n"
+  "<!-- <programme channel=\"comment\"></programme> -->\n"
+  "<channel id=\"outside\"><display-name>Outside the root</display-name></channel>\n"
+  "<tv generator-info-name=\"test\">\n"
+  "  <channel id=\"one&amp;two\">\n"
+  "    <display-name lang=\"en\">One &amp; Two</display-name>\n"
+  "  </channel>\n"
+  "  <channel id='single'><display-name>Single quoted</display-name></channel>\n"
+  "  <!-- <channel id=\"commented\"></channel> -->\n"
+  "  <programme start=\"20210315203000 +0000\" stop=\"20210315213000 +0000\" channel=\"one&amp;two\">\n"
+  "    <title>CDATA</title>\n"
+  "    <desc><![CDATA[Ends with </programme> and ]] and <!-- inside ]]></desc>\n"
+  "  </programme>\n"
+  "  <programme start=\"20210315213000 +0000\" title=\"a > b\" channel=\"single\">\n"
+  "    <desc><![CDATA[One]]><![CDATA[Two </programme>]]></desc>\n"
+  "  </programme>\n"
+  "  <programme start=\"20210315223000 +0000\" channel=\"empty\"/>\n"
+  "  <programmes channel=\"not-a-programme\"></programmes>\n"
+  "  <programme channel=\"&#x41;&#66;\" start=\"20210315233000 +0000\"><title>Entities</title></programme>\n"
+  "</tv>\n";
+
+struct ParsedElement
+{
+  XmltvElementType m_type;
+  std::string m_id;
+  std::string m_markup;
+  size_t m_offset;
+
+  bool operator==(const ParsedElement& right) const
+  {
+    return m_type == right.m_type && m_id == right.m_id && m_markup == right.m_markup && m_offset == right.m_offset;
+  }
+};
+
+std::ostream& operator<<(std::ostream& stream, const ParsedElement& element)
+{
+  return stream << (element.m_type == XmltvElementType::CHANNEL ? "channel '" : "programme '") << element.m_id
+                << "' at " << element.m_offset << ": " << element.m_markup;
+}
+
+ParsedElement MakeExpected(XmltvElementType type, const std::string& id, const std::string& startMarker, const std::string& endMarker)
+{
+  const size_t start = XMLTV_DATA.find(startMarker);
+  const size_t end = XMLTV_DATA.find(endMarker, start) + endMarker.size();
+  return {type, id, XMLTV_DATA.substr(start, end - start), start};
+}
+
+std::vector<ParsedElement> GetExpectedElements()
+{
+  return {
+    MakeExpected(XmltvElementType::CHANNEL, "one&two", "<channel id=\"one&amp;two\">", "</channel>"),
+    MakeExpected(XmltvElementType::CHANNEL, "single", "<channel id='single'>", "</channel>"),
+    MakeExpected(XmltvElementType::PROGRAMME, "one&two", "<programme start=\"20210315203000", "]]></desc>\n  </programme>"),
+    MakeExpected(XmltvElementType::PROGRAMME, "single", "<programme start=\"20210315213000", "]]></desc>\n  </programme>"),
+    MakeExpected(XmltvElementType::PROGRAMME, "empty", "<programme start=\"20210315223000", "/>"),
+    MakeExpected(XmltvElementType::PROGRAMME, "AB", "<programme channel=\"&#x41;", "</programme>"),
+  };
+}
+
+// Feeds the data to the parser in chunks of the given lengths, each in a buffer of its own
+// which is overwritten once parsed as the parser must have no further use for it
+std::vector<ParsedElement> ParseInChunks(const std::string& data, const std::vector<size_t>& chunkLengths, bool requireRootElement = true)
+{
+  std::vector<ParsedElement> elements;
+  XmltvParser parser([&elements](const XmltvElement& element)
+  {
+    elements.push_back({element.m_type, element.m_id, std::string(element.m_data, element.m_length), element.m_offset});
+    return true;
+  }, requireRootElement);
+
+  size_t position = 0;
+  size_t chunk = 0;
+  while (position < data.size())
+  {
+    const size_t length = std::min(chunkLengths[chunk++ % chunkLengths.size()], data.size() - position);
+    std::string buffer = data.substr(position, length);
+    EXPECT_TRUE(parser.Parse(&buffer[0], buffer.size()));
+    buffer.assign(buffer.size(), '#');
+    position += length;
+  }
+
+  EXPECT_TRUE(parser.Finish());
+  EXPECT_EQ(parser.GetBytesParsed(), data.size());
+  return elements;
+}
+
+} // unnamed namespace
+
+TEST(XmltvParserTest, FindsElementsInWholeData)
+{
+  const std::vector<ParsedElement> expected = GetExpectedElements();
+
+  const std::vector<ParsedElement> elements = ParseInChunks(XMLTV_DATA, {XMLTV_DATA.size()});
+  ASSERT_EQ(elements.size(), expected.size());
+  for (size_t i = 0; i < expected.size(); i++)
+    EXPECT_EQ(elements[i], expected[i]);
+}
+
+TEST(XmltvParserTest, FindsTheSameElementsWhereverTheDataIsSplit)
+{
+  const std::vector<ParsedElement> expected = ParseInChunks(XMLTV_DATA, {XMLTV_DATA.size()});
+
+  for (size_t split = 1; split < XMLTV_DATA.size(); split++)
+    EXPECT_EQ(ParseInChunks(XMLTV_DATA, {split, XMLTV_DATA.size()}), expected) << "split at " << split;
+}
+
+TEST(XmltvParserTest, FindsTheSameElementsForAnyChunkLength)
+{
+  const std::vector<ParsedElement> expected = ParseInChunks(XMLTV_DATA, {XMLTV_DATA.size()});
+
+  for (size_t chunkLength = 1; chunkLength <= 64; chunkLength++)
+    EXPECT_EQ(ParseInChunks(XMLTV_DATA, {chunkLength}), expected) << "chunks of " << chunkLength;
+
+  EXPECT_EQ(ParseInChunks(XMLTV_DATA, {1, 7, 2, 31, 3}), expected);
+}
+
+TEST(XmltvParserTest, FindsElementsWithoutRootElementWhenNotRequired)
+{
+  const std::string data = "<programme channel=\"a\"></programme>\n<channel id=\"b\"/>";
+  const std::vector<ParsedElement> elements = ParseInChunks(data, {5}, false);
+
+  ASSERT_EQ(elements.size(), 2u);
+  EXPECT_EQ(elements[0].m_id, "a");
+  EXPECT_EQ(elements[1].m_id, "b");
+  EXPECT_TRUE(ParseInChunks(data, {5}).empty());
+}
+
+TEST(XmltvParserTest, StopsWhenHandlerReturnsFalse)
+{
+  size_t handled = 0;
+  XmltvParser parser([&handled](const XmltvElement&) { return ++handled < 2; });
+
+  std::string data = XMLTV_DATA;
+  EXPECT_FALSE(parser.Parse(&data[0], data.size()));
+  EXPECT_TRUE(parser.IsAborted());
+  EXPECT_FALSE(parser.Finish());
+  EXPECT_EQ(handled, 2u);
+}
+
+TEST(XmltvParserTest, IncompleteElementIsNotFound)
+{
+  const std::string data = "<tv><programme channel=\"a\"><desc><![CDATA[</programme>";
+  EXPECT_TRUE(ParseInChunks(data, {data.size()}).empty());
+  EXPECT_TRUE(ParseInChunks(data, {3}).empty());
+}
+
+TEST(XmltvParserTest, GetElementAttributeReadsStartTag)
+{
+  std::vector<ParsedElement> elements = ParseInChunks(XMLTV_DATA, {XMLTV_DATA.size()});
+  ASSERT_EQ(elements.size(), 6u);
+
+  XmltvElement element{elements[3].m_type, &elements[3].m_markup[0], elements[3].m_markup.size(), elements[3].m_offset, elements[3].m_id};
+  std::string value;
+  EXPECT_TRUE(XmltvParser::GetElementAttribute(element, "title", value));
+  EXPECT_EQ(value, "a > b");
+  EXPECT_TRUE(XmltvParser::GetElementAttribute(element, "start", value));
+  EXPECT_EQ(value, "20210315213000 +0000");
+  EXPECT_FALSE(XmltvParser::GetElementAttribute(element, "stop", value));
+}
@@ -0,0 +1,231 @@
+/*
+ *  Copyright (C) 2005-2021 Team Kodi (https://kodi.tv)
+ *
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *  See LICENSE.md for more information.
+ */
+
+#include "../iptvsimple/utilities/XmltvScanUtils.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace iptvsimple::utilities;
+
+namespace
+{
+
+struct DateTime
+{
+  int year = 2000;
+  int mon = 1;
+  int mday = 1;
+  int hour = 0;
+  int min = 0;
+  int sec = 0;
+  char offsetSign = '+';
+  int offsetHours = 0;
+  int offsetMinutes = 0;
+
+  bool operator==(const DateTime& right) const
+  {
+    return year == right.year && mon == right.mon && mday == right.mday &&
+           hour == right.hour && min == right.min && sec == right.sec &&
+           offsetSign == right.offsetSign && offsetHours == right.offsetHours && offsetMinutes == right.offsetMinutes;
+  }
+};
+
+// How the XMLTV date times were read before the scanners replaced sscanf()
+DateTime ScanDateTimeWithSscanf(const std::string& text)
+{
+  DateTime dateTime;
+  std::sscanf(text.c_str(), "%04d%02d%02d%02d%02d%02d %c%02d%02d", &dateTime.year, &dateTime.mon, &dateTime.mday,
+              &dateTime.hour, &dateTime.min, &dateTime.sec, &dateTime.offsetSign, &dateTime.offsetHours, &dateTime.offsetMinutes);
+  return dateTime;
+}
+
+DateTime ScanDateTime(const std::string& text)
+{
+  DateTime dateTime;
+  const char* position = text.c_str();
+  if (XmltvScanUtils::ScanDate(position, dateTime.year, dateTime.mon, dateTime.mday))
+    XmltvScanUtils::ScanTime(position, dateTime.hour, dateTime.min, dateTime.sec,
+                             dateTime.offsetSign, dateTime.offsetHours, dateTime.offsetMinutes);
+  return dateTime;
+}
+
+bool IsXmltvDateWithRegex(const std::string& text)
+{
+  static const std::regex dateRegex("^[1-9][0-9][0-9][0-9][0-9][0-9][0-9][0-9]");
+  return std::regex_match(text, dateRegex);
+}
+
+// How onscreen episode numbers were read before, returns false if there was no match
+bool ParseOnScreenEpisodeNumberWithRegex(const std::string& episodeNumberString, int& seasonNumber, int& episodeNumber)
+{
+  static const std::regex unwantedCharsRegex("[ \\txX_\\.]");
+  const std::string text = std::regex_replace(episodeNumberString, unwantedCharsRegex, "");
+
+  std::smatch match;
+  static const std::regex seasonEpisodeRegex("^[sS]([0-9][0-9]*)[eE][pP]?([0-9][0-9]*)$");
+  static const std::regex episodeOnlyRegex("^[eE][pP]?([0-9][0-9]*)$");
+  if (std::regex_match(text, match, seasonEpisodeRegex))
+  {
+    seasonNumber = std::atoi(match[1].str().c_str());
+    episodeNumber = std::atoi(match[2].str().c_str());
+    return true;
+  }
+  else if (std::regex_match(text, match, episodeOnlyRegex))
+  {
+    episodeNumber = std::atoi(match[1].str().c_str());
+    return true;
+  }
+
+  return false;
+}
+
+// Strings made from the characters the scanners treat specially, with runs of digits short
+// enough to always fit in an int so the old atoi() and sscanf() calls were well defined
+std::vector<std::string> MakeRandomStrings(const std::string& alphabet, size_t maxLength, size_t count)
+{
+  std::mt19937 random(12345);
+  std::vector<std::string> strings;
+  while (strings.size() < count)
+  {
+    std::string text;
+    const size_t length = random() % (maxLength + 1);
+    size_t digitRun = 0;
+    while (text.size() < length)
+    {
+      const char c = alphabet[random() % alphabet.size()];
+      digitRun = c >= '0' && c <= '9' ? digitRun + 1 : 0;
+      if (digitRun <= 9)
+        text += c;
+    }
+    strings.emplace_back(std::move(text));
+  }
+  return strings;
+}
+
+} // unnamed namespace
+
+TEST(XmltvScanUtilsTest, ScanIntReadsLikeSscanf)
+{
+  const std::vector<std::string> inputs = {"", " ", "0", "42", "  -17x", "+5", "-", "+", "- 5", "12345", "007", "\t\n9", "a1"};
+
+  for (const std::string& input : inputs)
+  {
+    for (int width : {0, 1, 2, 4})
+    {
+      int expected = -1;
+      int value = -1;
+      const std::string format = width > 0 ? "%" + std::to_string(width) + "d" : "%d";
+      const bool expectedRead = std::sscanf(input.c_str(), format.c_str(), &expected) == 1;
+
+      const char* position = input.c_str();
+      EXPECT_EQ(XmltvScanUtils::ScanInt(position, width, value), expectedRead) << "'" << input << "' width " << width;
+      EXPECT_EQ(value, expected) << "'" << input << "' width " << width;
+    }
+  }
+}
+
+TEST(XmltvScanUtilsTest, ScanIntMovesPastDigitsTooBigForAnInt)
+{
+  const std::string input = "123456789012345678901234567890/2";
+  const char* position = input.c_str();
+  int value = 0;
+
+  EXPECT_TRUE(XmltvScanUtils::ScanInt(position, 0, value));
+  EXPECT_EQ(*position, '/');
+}
+
+TEST(XmltvScanUtilsTest, ScanDateTimeReadsLikeSscanf)
+{
+  const std::vector<std::string> inputs = {
+    "20210315203000 +0100",
+    "20210315203000 -0530",
+    "20210315203000+0100",
+    "20210315203000",
+    "202103152030",
+    "20210315",
+    "2021031520",
+    "2021",
+    "",
+    "garbage",
+    "2021-03-15 20:30:00",
+    "20210315 203000 +0100",
+    "20210315203000 Z",
+    "20210315203000 +01",
+    "  20210315203000   +0100",
+    "-0210315203000 +0100",
+    "20210315203000 +01x0",
+  };
+
+  for (const std::string& input : inputs)
+    EXPECT_TRUE(ScanDateTime(input) == ScanDateTimeWithSscanf(input)) << "'" << input << "'";
+
+  for (const std::string& input : MakeRandomStrings("0123456789 +-Zx", 24, 20000))
+    EXPECT_TRUE(ScanDateTime(input) == ScanDateTimeWithSscanf(input)) << "'" << input << "'";
+}
+
+TEST(XmltvScanUtilsTest, IsXmltvDateMatchesRegex)
+{
+  const std::vector<std::string> inputs = {"20210315", "02021031", "2021031", "202103150", "2021031a", "", "19700101", " 2021031"};
+
+  for (const std::string& input : inputs)
+    EXPECT_EQ(XmltvScanUtils::IsXmltvDate(input), IsXmltvDateWithRegex(input)) << "'" << input << "'";
+
+  for (const std::string& input : MakeRandomStrings("0123456789a ", 10, 20000))
+    EXPECT_EQ(XmltvScanUtils::IsXmltvDate(input), IsXmltvDateWithRegex(input)) << "'" << input << "'";
+}
+
+TEST(XmltvScanUtilsTest, ParseOnScreenEpisodeNumberMatchesRegex)
+{
+  const std::vector<std::string> inputs = {
+    "S01E02", "s1e2", "S 01 x E 02", "S01EP02", "S01E02P", "E12", "ep 7", "EP", "S01", "S01E", "SE01",
+    "S01E02 Part 1", "1x02", "S01.E02", "S_1_E_2", "S01E02x", "", "S", "E", "S01Ex02", "S01PE02", "S1E2E3",
+  };
+
+  auto check = [](const std::string& input)
+  {
+    int expectedSeason = -1;
+    int expectedEpisode = -1;
+    int season = -1;
+    int episode = -1;
+    const bool expected = ParseOnScreenEpisodeNumberWithRegex(input, expectedSeason, expectedEpisode);
+
+    EXPECT_EQ(XmltvScanUtils::ParseOnScreenEpisodeNumber(input, season, episode), expected) << "'" << input << "'";
+    EXPECT_EQ(season, expectedSeason) << "'" << input << "'";
+    EXPECT_EQ(episode, expectedEpisode) << "'" << input << "'";
+  };
+
+  for (const std::string& input : inputs)
+    check(input);
+
+  for (const std::string& input : MakeRandomStrings("0123456789sSeEpPxX_. \t", 12, 50000))
+    check(input);
+}
+
+TEST(XmltvScanUtilsTest, ParseOnScreenEpisodeNumberRejectsNumbersTooBigForAnInt)
+{
+  int season = -1;
+  int episode = -1;
+
+  EXPECT_TRUE(XmltvScanUtils::ParseOnScreenEpisodeNumber("S2147483647E2147483647", season, episode));
+  EXPECT_EQ(season, 2147483647);
+  EXPECT_EQ(episode, 2147483647);
+
+  season = -1;
+  episode = -1;
+  EXPECT_FALSE(XmltvScanUtils::ParseOnScreenEpisodeNumber("S2147483648E1", season, episode));
+  EXPECT_FALSE(XmltvScanUtils::ParseOnScreenEpisodeNumber("S1E2147483648", season, episode));
+  EXPECT_FALSE(XmltvScanUtils::ParseOnScreenEpisodeNumber("E99999999999999999999999", season, episode));
+  EXPECT_EQ(season, -1);
+  EXPECT_EQ(episode, -1);
+}